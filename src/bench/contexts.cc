@@ -0,0 +1,163 @@
+/***************************************************************************************************
+    File: contexts.cc
+
+    Description:
+        What order-1 context modelling (compress -1) buys over the order-0 code, and what it
+        costs in speed, on the files given:
+
+            make bench && builds/bench_contexts file ...
+
+        prints one JSON object per file and code, so runs can be kept and compared. The
+        order-0 code is that of compress -c; the context codes are built with 1, 4, 16 (the
+        default) and 64 groups at most, and a group count of 1 is the order-0 code in the
+        context format. For each code:
+
+            ratio               header and bits over the size of the file
+            groups              groups the contexts were clustered into
+            model_ms            counting and building the code, once
+            encode, decode      coding the whole file in memory, in MB/s of the file
+
+        Each phase runs for at least a fifth of a second.
+
+***************************************************************************************************/
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "../codec/bitReader.h"
+#include "../codec/bitWriter.h"
+#include "../codec/canonical.h"
+#include "../codec/contextModel.h"
+#include "../codec/decodeTable.h"
+#include "../codec/histogram.h"
+#include "../codec/huffmanTree.h"
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+double seconds_since(clock_type::time_point start) {
+    return std::chrono::duration<double>(clock_type::now() - start).count();
+}
+
+template <typename Phase>
+double seconds_per_pass(Phase phase) {
+    // repeat the phase for at least a fifth of a second
+
+    clock_type::time_point start = clock_type::now();
+    double elapsed = 0;
+    size_t passes = 0;
+    while (elapsed < 0.2) {
+        phase();
+        passes++;
+        elapsed = seconds_since(start);
+    }
+    return elapsed / passes;
+}
+
+void report(const char *file, const char *code, size_t size, size_t compressed, size_t groups,
+            double model, double encode, double decode, bool ok) {
+    if (!ok) std::fprintf(stderr, "bench_contexts: %s does not decode to itself\n", file);
+    double mb = size / 1e6;
+    std::printf("{\"file\": \"%s\", \"code\": \"%s\", \"bytes\": %zu, \"ratio\": %.5f, "
+                "\"groups\": %zu, \"model_ms\": %.3f, \"encode_mbs\": %.1f, "
+                "\"decode_mbs\": %.1f}\n",
+                file, code, size, (double)compressed / size, groups, model * 1e3, mb / encode,
+                mb / decode);
+    std::fflush(stdout);
+}
+
+void order0(const char *file, const std::vector<unsigned char> & data) {
+    // the canonical format: one code, decoded with the multi-symbol tables when they apply
+
+    size_t size = data.size();
+    clock_type::time_point start = clock_type::now();
+    size_t counts[256] = {};
+    count_bytes(data.data(), size, counts);
+    unsigned char lengths[256];
+    uint64_t codes[256];
+    make_code_lengths(counts, lengths, 0);
+    make_canonical_codes(lengths, codes, 256);
+    double model = seconds_since(start);
+
+    unsigned max_length = *std::max_element(lengths, lengths + 256);
+    std::vector<unsigned char> bits(size * max_length / 8 + 16);
+    size_t bytes = 0;
+    double encode = seconds_per_pass([&] {
+        bit_writer writer(bits.data());
+        for (size_t i = 0; i < size; i++) writer.put(codes[data[i]], lengths[data[i]]);
+        writer.flush();
+        bytes = writer.size();
+    });
+    unsigned char table[code_lengths_bound(256)];
+    size_t header = 13 + write_code_lengths(lengths, 256, table);
+
+    decode_table decoder;
+    decoder.build(codes, lengths, 256);
+    std::vector<unsigned char> out(size);
+    double decode = seconds_per_pass([&] {
+        bit_reader reader(bits.data(), bytes);
+        decoder.decode(reader, out.data(), size);
+    });
+    report(file, "order0", size, header + bytes, 1, model, encode, decode, out == data);
+}
+
+void order1(const char *file, const std::vector<unsigned char> & data, unsigned max_groups) {
+    size_t size = data.size();
+    clock_type::time_point start = clock_type::now();
+    std::vector<size_t> counts(256 * 256);
+    count_contexts(data.data(), size, counts.data());
+    context_code code;
+    build_context_code(counts.data(), max_groups, 0, code);
+    double model = seconds_since(start);
+
+    std::vector<unsigned char> bits(size * code.max_length / 8 + 16);
+    size_t bytes = 0;
+    double encode = seconds_per_pass([&] {
+        bit_writer writer(bits.data());
+        encode_contexts(code, data.data(), size, 0, writer);
+        writer.flush();
+        bytes = writer.size();
+    });
+    std::vector<unsigned char> head(CONTEXT_HEAD_BOUND);
+    size_t header = write_context_header(code, size, head.data());
+
+    context_decoder decoder;
+    decoder.build(code);
+    std::vector<unsigned char> out(size);
+    double decode = seconds_per_pass([&] {
+        bit_reader reader(bits.data(), bytes);
+        unsigned char previous = 0;
+        decoder.decode(reader, out.data(), size, previous);
+    });
+    std::string name = "order1_" + std::to_string(max_groups);
+    report(file, name.c_str(), size, header + bytes, code.groups.size(), model, encode, decode,
+           out == data);
+}
+
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::fprintf(stderr, "usage: bench_contexts file ...\n");
+        return 1;
+    }
+    for (int i = 1; i < argc; i++) {
+        std::ifstream in(argv[i], std::ios::binary);
+        std::vector<unsigned char> data((std::istreambuf_iterator<char>(in)),
+                                        std::istreambuf_iterator<char>());
+        if (!in.eof() && !in) {
+            std::fprintf(stderr, "bench_contexts: cannot read %s\n", argv[i]);
+            return 1;
+        }
+        if (data.empty()) continue;
+        order0(argv[i], data);
+        for (unsigned groups : {1u, 4u, DEFAULT_CONTEXT_GROUPS, MAX_CONTEXT_GROUPS}) {
+            order1(argv[i], data, groups);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,289 @@
+/***************************************************************************************************
+    File: corpus.cc
+
+    Description:
+        Throughput of every phase of block compression on generated corpora: uniform random
+        bytes, a Zipf distribution, text-like words, a single repeated byte and data that is
+        already compressed. Each corpus is cut into blocks, and each phase runs over all of
+        them for at least a fifth of a second:
+
+            make bench && builds/bench_corpus [size [block size]]
+
+        prints one JSON object per corpus (16M and 1M blocks by default, sizes take K or M),
+        so runs can be kept and compared:
+
+            histogram           count_bytes
+            tree_heap           make_code_lengths with the min_heap tree builder
+            tree_list           the same with the priority_queue builder
+            tree_sorted         the same with the sorted counts, as compress does
+            codes               make_canonical_codes from the lengths
+            encode, decode      encode_block and decode_block, whole frames
+
+        Speeds are in MB/s of the corpus and tree builders also in nanoseconds per code.
+        ratio is the size of the frames over the size of the corpus, and coded, stored and
+        run count the blocks of each kind: a stored block (random and compressed data, which
+        coding would not shrink) decodes as a copy and a run as a fill, so their decode
+        speed is not that of the decoder. Allocations are counted
+        by replacing operator new, over the first pass of encoding (fresh frames) and of
+        decoding (a reused decode table). peak_rss_kb is the peak of the whole process so
+        far, so it only grows from one corpus to the next.
+
+***************************************************************************************************/
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#include "../codec/block.h"
+#include "../codec/canonical.h"
+#include "../codec/histogram.h"
+#include "../codec/huffmanTree.h"
+#include "../lib/huffman.h"
+
+namespace {
+
+std::atomic<size_t> allocations(0);
+
+}
+
+void *operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+
+namespace {
+
+// a 64-bit linear congruential generator, so every run sees the same corpora
+struct generator {
+    uint64_t state = 0x9e3779b97f4a7c15;
+
+    uint32_t next() {
+        state = state * 6364136223846793005 + 1442695040888963407;
+        return (uint32_t)(state >> 32);
+    }
+    double uniform() { return next() / 4294967296.0; }
+};
+
+// picks ranks 0 to n - 1 with probability proportional to 1 / (rank + 1)
+struct zipf {
+    std::vector<double> cumulative;
+
+    explicit zipf(size_t n) : cumulative(n) {
+        double sum = 0;
+        for (size_t r = 0; r < n; r++) cumulative[r] = sum += 1.0 / (r + 1);
+        for (double & c : cumulative) c /= sum;
+    }
+    size_t pick(generator & random) const {
+        double u = random.uniform();
+        size_t lo = 0, hi = cumulative.size() - 1;
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (cumulative[mid] < u) lo = mid + 1;
+            else hi = mid;
+        }
+        return lo;
+    }
+};
+
+std::vector<unsigned char> random_corpus(size_t size) {
+    std::vector<unsigned char> data(size);
+    generator random;
+    for (unsigned char & c : data) c = (unsigned char)random.next();
+    return data;
+}
+
+std::vector<unsigned char> zipf_corpus(size_t size) {
+    // the ranks are shuffled over the byte values, so frequent bytes are not all small
+    std::vector<unsigned char> data(size);
+    generator random;
+    unsigned char symbol[256];
+    for (int i = 0; i < 256; i++) symbol[i] = (unsigned char)i;
+    for (int i = 255; i > 0; i--) std::swap(symbol[i], symbol[random.next() % (i + 1)]);
+    zipf ranks(256);
+    for (unsigned char & c : data) c = symbol[ranks.pick(random)];
+    return data;
+}
+
+std::vector<unsigned char> text_corpus(size_t size) {
+    // words of lowercase letters drawn with English letter frequencies, used with Zipf
+    // frequencies, in sentences and lines
+
+    static const char letters[] = "eeeeeeeeeeeetttttttttaaaaaaaaoooooooiiiiiiinnnnnnnsssssshhhhhh"
+                                  "rrrrrrddddllllcccuuummmwwffggyyppbbvkjxqz";
+    generator random;
+    std::vector<std::string> words(4096);
+    for (std::string & word : words) {
+        size_t length = 1 + random.next() % 4 + random.next() % 6;
+        for (size_t i = 0; i < length; i++) word += letters[random.next() % (sizeof(letters) - 1)];
+    }
+    zipf ranks(words.size());
+
+    std::vector<unsigned char> data;
+    data.reserve(size + 16);
+    bool capital = true;
+    size_t line = 0;
+    while (data.size() < size) {
+        const std::string & word = words[ranks.pick(random)];
+        size_t start = data.size();
+        data.insert(data.end(), word.begin(), word.end());
+        if (capital) data[start] = (unsigned char)(data[start] - 'a' + 'A');
+        capital = random.next() % 12 == 0;
+        if (capital) data.push_back('.');
+        else if (random.next() % 16 == 0) data.push_back(',');
+        line += word.size() + 1;
+        if (line > 72) {
+            data.push_back('\n');
+            line = 0;
+        }
+        else data.push_back(' ');
+    }
+    data.resize(size);
+    return data;
+}
+
+std::vector<unsigned char> single_corpus(size_t size) {
+    return std::vector<unsigned char>(size, 'a');
+}
+
+std::vector<unsigned char> compressed_corpus(size_t size) {
+    // text compressed with the library, repeated until it fills the corpus
+    std::vector<unsigned char> text = text_corpus(size);
+    std::vector<unsigned char> data(huffman::compress_bound(size));
+    size_t n = huffman::compress(text.data(), size, data.data(), data.size());
+    data.resize(n);
+    while (data.size() < size) data.insert(data.end(), data.begin(), data.begin() + n);
+    data.resize(size);
+    return data;
+}
+
+template <typename Phase>
+double seconds_per_pass(Phase phase) {
+    // repeat the phase for at least a fifth of a second
+
+    using clock = std::chrono::steady_clock;
+    clock::time_point start = clock::now();
+    double elapsed = 0;
+    size_t passes = 0;
+    while (elapsed < 0.2) {
+        phase();
+        passes++;
+        elapsed = std::chrono::duration<double>(clock::now() - start).count();
+    }
+    return elapsed / passes;
+}
+
+long peak_rss_kb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+bool parse_size(const char *text, size_t & size) {
+    char *end;
+    size = std::strtoull(text, &end, 10);
+    if (*end == 'K' || *end == 'k') size <<= 10, end++;
+    else if (*end == 'M' || *end == 'm') size <<= 20, end++;
+    return *end == 0 && size > 0;
+}
+
+void run(const char *name, const std::vector<unsigned char> & data, size_t block_size) {
+    size_t blocks = (data.size() + block_size - 1) / block_size;
+    auto block = [&](size_t b) { return data.data() + b * block_size; };
+    auto block_length = [&](size_t b) { return std::min(block_size, data.size() - b * block_size); };
+    double mb = data.size() / 1e6;
+
+    std::vector<size_t> counts(blocks * 256);
+    double histogram = seconds_per_pass([&] {
+        std::fill(counts.begin(), counts.end(), 0);
+        for (size_t b = 0; b < blocks; b++) count_bytes(block(b), block_length(b), &counts[b * 256]);
+    });
+
+    std::vector<unsigned char> lengths(blocks * 256);
+    auto tree = [&](tree_builder builder) {
+        return seconds_per_pass([&] {
+            for (size_t b = 0; b < blocks; b++) {
+                make_code_lengths(&counts[b * 256], &lengths[b * 256], 0, builder);
+            }
+        });
+    };
+    double tree_heap = tree(TREE_BUILDER_HEAP);
+    double tree_list = tree(TREE_BUILDER_LIST);
+    double tree_sorted = tree(TREE_BUILDER_SORTED);
+
+    uint64_t codes[256];
+    double code_time = seconds_per_pass([&] {
+        for (size_t b = 0; b < blocks; b++) make_canonical_codes(&lengths[b * 256], codes, 256);
+    });
+
+    std::vector<std::vector<unsigned char>> frames(blocks);
+    size_t before = allocations;
+    size_t compressed = 0;
+    for (size_t b = 0; b < blocks; b++) {
+        encode_block(block(b), block_length(b), 0, DEFAULT_STREAMS, DEFAULT_MIN_GAIN, frames[b]);
+        compressed += frames[b].size();
+    }
+    size_t encode_allocs = allocations - before;
+    size_t kinds[3] = {};
+    for (size_t b = 0; b < blocks; b++) kinds[block_type(frames[b].data())]++;
+    double encode = seconds_per_pass([&] {
+        for (size_t b = 0; b < blocks; b++) {
+            encode_block(block(b), block_length(b), 0, DEFAULT_STREAMS, DEFAULT_MIN_GAIN, frames[b]);
+        }
+    });
+
+    std::vector<unsigned char> out(block_size);
+    decode_table table;
+    bool ok = true;
+    before = allocations;
+    for (size_t b = 0; b < blocks; b++) {
+        ok = ok && decode_block(frames[b].data(), frames[b].size(), out.data(), table);
+        ok = ok && std::equal(out.begin(), out.begin() + block_length(b), block(b));
+    }
+    size_t decode_allocs = allocations - before;
+    double decode = seconds_per_pass([&] {
+        for (size_t b = 0; b < blocks; b++) {
+            decode_block(frames[b].data(), frames[b].size(), out.data(), table);
+        }
+    });
+    if (!ok) std::fprintf(stderr, "bench_corpus: %s does not decode to itself\n", name);
+
+    std::printf("{\"corpus\": \"%s\", \"bytes\": %zu, \"block_size\": %zu, "
+                "\"histogram_mbs\": %.1f, \"tree_heap_mbs\": %.1f, \"tree_list_mbs\": %.1f, "
+                "\"tree_sorted_mbs\": %.1f, \"tree_heap_ns\": %.0f, \"tree_list_ns\": %.0f, "
+                "\"tree_sorted_ns\": %.0f, \"codes_mbs\": %.1f, \"encode_mbs\": %.1f, "
+                "\"decode_mbs\": %.1f, \"ratio\": %.5f, \"coded\": %zu, \"stored\": %zu, "
+                "\"run\": %zu, \"encode_allocs\": %zu, \"decode_allocs\": %zu, "
+                "\"peak_rss_kb\": %ld}\n",
+                name, data.size(), block_size, mb / histogram, mb / tree_heap, mb / tree_list,
+                mb / tree_sorted, tree_heap * 1e9 / blocks, tree_list * 1e9 / blocks,
+                tree_sorted * 1e9 / blocks, mb / code_time, mb / encode, mb / decode,
+                (double)compressed / data.size(), kinds[BLOCK_CODED], kinds[BLOCK_STORED],
+                kinds[BLOCK_RUN], encode_allocs, decode_allocs, peak_rss_kb());
+    std::fflush(stdout);
+}
+
+}
+
+int main(int argc, char **argv) {
+    size_t size = 16 << 20, block_size = DEFAULT_BLOCK_SIZE;
+    if ((argc > 1 && !parse_size(argv[1], size)) ||
+        (argc > 2 && (!parse_size(argv[2], block_size) || block_size < MIN_BLOCK_SIZE ||
+                      block_size > MAX_BLOCK_SIZE)) || argc > 3) {
+        std::fprintf(stderr, "usage: bench_corpus [size [block size]]\n");
+        return 1;
+    }
+
+    run("random", random_corpus(size), block_size);
+    run("zipf", zipf_corpus(size), block_size);
+    run("text", text_corpus(size), block_size);
+    run("single", single_corpus(size), block_size);
+    run("compressed", compressed_corpus(size), block_size);
+    return 0;
+}
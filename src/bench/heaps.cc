@@ -0,0 +1,172 @@
+/***************************************************************************************************
+    File: heaps.cc
+
+    Description:
+        Microbenchmark of the queues in src/queue. Every queue takes n random keys and gives
+        them all back, for n from 256 (a Huffman tree) up to a million (a scheduler):
+
+            make bench && builds/bench_heaps
+
+        prints the nanoseconds per key for each queue and size. "before" is min_heap as it
+        was before comparators became part of its type: a binary heap with a function
+        pointer comparator, recursive sifting and copies through a temporary. The linked
+        list priority_queue adds in linear time, so it only runs up to 16K keys.
+
+***************************************************************************************************/
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "../queue/minHeap.h"
+#include "../queue/priorityQueue.h"
+
+namespace before {
+
+template <typename T>
+class min_heap {
+    private:
+        size_t _capacity;
+        size_t _size;
+        int (*_cmp)(const T &, const T &);
+        T *_data;
+
+        void _swap(size_t x, size_t y) {
+            T temp = _data[x];
+            _data[x] = _data[y];
+            _data[y] = temp;
+        }
+
+        void _reheap_down(size_t k) {
+            if (k * 2 + 1 >= _size) return;
+            size_t child = k * 2 + 1;
+            if (child + 1 < _size && _cmp(_data[child + 1], _data[child]) < 0) child++;
+            if (_cmp(_data[k], _data[child]) > 0) {
+                _swap(k, child);
+                _reheap_down(child);
+            }
+        }
+
+    public:
+        min_heap(int (*cmp)(const T &, const T &))
+            : _capacity(256), _size(0), _cmp(cmp), _data(new T[256]) {}
+        ~min_heap() { delete[] _data; }
+
+        void add(const T & item) {
+            size_t k = _size++;
+            _data[k] = item;
+            while (k > 0 && _cmp(_data[k], _data[(k - 1) / 2]) < 0) {
+                _swap(k, (k - 1) / 2);
+                k = (k - 1) / 2;
+            }
+            if (_size == _capacity) {
+                T *bigger = new T[_capacity *= 2];
+                for (size_t i = 0; i < _size; i++) bigger[i] = _data[i];
+                delete[] _data;
+                _data = bigger;
+            }
+        }
+
+        void remove() {
+            _data[0] = _data[--_size];
+            _reheap_down(0);
+        }
+
+        T front() const { return _data[0]; }
+        size_t size() const { return _size; }
+};
+
+}
+
+namespace {
+
+int key_cmp(const uint64_t & a, const uint64_t & b) {
+    return a < b ? -1 : a > b;
+}
+
+bool key_less(const uint64_t & a, const uint64_t & b) {
+    return a < b;
+}
+
+using clock = std::chrono::steady_clock;
+
+template <typename Queue>
+double time_adds(const std::vector<uint64_t> & keys, Queue make, bool & sorted) {
+    // add the keys one by one and take them all back, repeating for a fifth of a second
+
+    size_t rounds = 0;
+    clock::time_point start = clock::now();
+    double elapsed = 0;
+    sorted = true;
+    while (elapsed < 0.2) {
+        auto queue = make();
+        for (uint64_t key : keys) queue.add(key);
+        uint64_t last = 0;
+        while (queue.size() > 0) {
+            sorted &= queue.front() >= last;
+            last = queue.front();
+            queue.remove();
+        }
+        rounds++;
+        elapsed = std::chrono::duration<double>(clock::now() - start).count();
+    }
+    return elapsed * 1e9 / (rounds * keys.size());
+}
+
+template <typename Heap>
+double time_heapify(const std::vector<uint64_t> & keys, bool & sorted) {
+    // build the heap from all the keys at once, then take them all back
+
+    size_t rounds = 0;
+    clock::time_point start = clock::now();
+    double elapsed = 0;
+    sorted = true;
+    while (elapsed < 0.2) {
+        Heap heap(keys.begin(), keys.end());
+        uint64_t last = 0;
+        while (!heap.empty()) {
+            uint64_t key = heap.take();
+            sorted &= key >= last;
+            last = key;
+        }
+        rounds++;
+        elapsed = std::chrono::duration<double>(clock::now() - start).count();
+    }
+    return elapsed * 1e9 / (rounds * keys.size());
+}
+
+void report(const char *name, size_t n, double ns, bool sorted) {
+    std::printf("%-28s %8zu %10.1f%s\n", name, n, ns, sorted ? "" : "  (out of order)");
+}
+
+}
+
+int main() {
+    std::mt19937_64 random(1);
+    std::printf("%-28s %8s %10s\n", "queue", "keys", "ns/key");
+    for (size_t n = 256; n <= (1 << 20); n *= 8) {
+        std::vector<uint64_t> keys(n);
+        for (uint64_t & key : keys) key = random();
+        bool sorted;
+
+        double ns = time_adds(keys, [] { return before::min_heap<uint64_t>(key_cmp); }, sorted);
+        report("before", n, ns, sorted);
+        ns = time_adds(keys, [] {
+            return min_heap<uint64_t, bool (*)(const uint64_t &, const uint64_t &)>(key_less);
+        }, sorted);
+        report("min_heap, function pointer", n, ns, sorted);
+        ns = time_adds(keys, [] { return min_heap<uint64_t>(); }, sorted);
+        report("min_heap", n, ns, sorted);
+        ns = time_adds(keys, [] { return min_heap<uint64_t, std::less<uint64_t>, 4>(); }, sorted);
+        report("min_heap, 4-ary", n, ns, sorted);
+        ns = time_heapify<min_heap<uint64_t>>(keys, sorted);
+        report("min_heap, heapify", n, ns, sorted);
+        ns = time_heapify<min_heap<uint64_t, std::less<uint64_t>, 4>>(keys, sorted);
+        report("min_heap, 4-ary heapify", n, ns, sorted);
+        if (n <= (16 << 10)) {
+            ns = time_adds(keys, [] { return priority_queue<uint64_t>(); }, sorted);
+            report("priority_queue", n, ns, sorted);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,96 @@
+/***************************************************************************************************
+    File: treeBuilders.cc
+
+    Description:
+        Benchmark of the two ways make_code_lengths finds code lengths: the Huffman tree built
+        with min_heap, and the sorted counts of sorted_code_lengths. The input (a file, or
+        16M of generated data skewed like text) is cut into blocks of each size, and the
+        code of every block is built with each builder:
+
+            make bench && builds/bench_trees [file]
+
+        prints one line per block size with the nanoseconds per code of each builder.
+
+***************************************************************************************************/
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <vector>
+#include "../codec/histogram.h"
+#include "../codec/huffmanTree.h"
+
+namespace {
+
+std::vector<unsigned char> generated_data(size_t size) {
+    // bytes with roughly geometric frequencies, a few common and many rare: groups of
+    // four bytes, each group half as likely as the one before
+
+    std::vector<unsigned char> data(size);
+    uint64_t state = 0x9e3779b97f4a7c15;
+    for (size_t i = 0; i < size; i++) {
+        state = state * 6364136223846793005 + 1442695040888963407;
+        unsigned group = __builtin_ctzll((state >> 20) | ((uint64_t)1 << 43));
+        data[i] = (unsigned char)(group * 4 + (state >> 62));
+    }
+    return data;
+}
+
+double time_builder(const std::vector<size_t> & counts, tree_builder builder, size_t & cost) {
+    // nanoseconds per code, repeating the blocks for at least a fifth of a second
+
+    using clock = std::chrono::steady_clock;
+    size_t blocks = counts.size() / 256;
+    unsigned char lengths[256];
+    size_t codes = 0;
+    cost = 0;
+    clock::time_point start = clock::now();
+    double elapsed = 0;
+    for (bool first = true; elapsed < 0.2; first = false) {
+        for (size_t b = 0; b < blocks; b++) {
+            const size_t *block = counts.data() + b * 256;
+            make_code_lengths(block, lengths, 0, builder);
+            if (first) {
+                for (int c = 0; c < 256; c++) cost += block[c] * lengths[c];
+            }
+        }
+        codes += blocks;
+        elapsed = std::chrono::duration<double>(clock::now() - start).count();
+    }
+    return elapsed * 1e9 / codes;
+}
+
+}
+
+int main(int argc, char **argv) {
+    std::vector<unsigned char> data;
+    if (argc > 1) {
+        std::ifstream file(argv[1], std::ios::binary);
+        if (!file) {
+            std::perror(argv[1]);
+            return 1;
+        }
+        data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    else {
+        data = generated_data(16 << 20);
+    }
+
+    std::printf("%10s %8s %10s %10s %8s\n", "block", "blocks", "heap ns", "sorted ns", "speedup");
+    for (size_t block_size = 4 << 10; block_size <= (1 << 20); block_size *= 4) {
+        size_t blocks = data.size() / block_size;
+        if (blocks == 0) break;
+        std::vector<size_t> counts(blocks * 256);
+        for (size_t b = 0; b < blocks; b++) {
+            count_bytes(data.data() + b * block_size, block_size, counts.data() + b * 256);
+        }
+
+        size_t heap_cost, sorted_cost;
+        double heap = time_builder(counts, TREE_BUILDER_HEAP, heap_cost);
+        double sorted = time_builder(counts, TREE_BUILDER_SORTED, sorted_cost);
+        std::printf("%10zu %8zu %10.0f %10.0f %7.2fx%s\n", block_size, blocks, heap, sorted,
+                    heap / sorted, heap_cost == sorted_cost ? "" : "  (sizes differ)");
+    }
+    return 0;
+}
@@ -0,0 +1,88 @@
+/***************************************************************************************************
+    File: bitReader.h
+
+    Description:
+        A bit reader that pulls the compressed bit-stream out of a memory buffer 64 bits at a
+        time. Bits are consumed most-significant first, which is the order write_compress packs
+        them into bytes. The reader keeps between 56 and 63 valid bits at the top of a 64-bit
+        word after each refill, so a decoder can look at the next several codes without touching
+        memory again. Reading past the end of the buffer yields zero bits, matching the zero
+        padding of the last compressed byte.
+
+***************************************************************************************************/
+#ifndef BIT_READER_H
+#define BIT_READER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+inline uint64_t load_be64(const unsigned char *p) {
+    // load 8 bytes as a big-endian word
+
+    uint64_t word;
+    std::memcpy(&word, p, sizeof(word));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    word = __builtin_bswap64(word);
+#endif
+    return word;
+}
+
+class bit_reader {
+    private:
+        const unsigned char *_start;    // first byte of the buffer
+        const unsigned char *_p;        // next byte not yet fully loaded into _buf
+        const unsigned char *_end;      // one past the last byte of the buffer
+        uint64_t _buf;                  // valid bits live at the top of the word
+        unsigned _bits;                 // number of valid bits in _buf
+        size_t _overrun;                // zero bytes loaded past the end of the buffer
+
+    public:
+        bit_reader(const unsigned char *data = nullptr, size_t size = 0)
+            : _start(data), _p(data), _end(data + size), _buf(0), _bits(0), _overrun(0) {}
+
+        // make sure at least 56 bits are available
+        inline void refill() {
+            if (_end - _p >= 8) {
+                // branchless refill: load a whole word and only advance by the bytes that
+                // fully fit. The partially loaded byte is loaded again on the next refill.
+                _buf |= load_be64(_p) >> _bits;
+                _p += (63 - _bits) >> 3;
+                _bits |= 56;
+            }
+            else {
+                while (_bits <= 56) {
+                    uint64_t byte = 0;
+                    if (_p < _end) byte = *_p++;
+                    else _overrun++;
+                    _buf |= byte << (56 - _bits);
+                    _bits += 8;
+                }
+            }
+        }
+
+        // return the next n bits (1 <= n <= _bits) without consuming them
+        inline uint64_t peek(unsigned n) const { return _buf >> (64 - n); }
+
+        // drop the next n bits (n <= _bits)
+        inline void consume(unsigned n) { _buf <<= n; _bits -= n; }
+
+        // number of bits already handed out since the start of the buffer
+        size_t position() const { return (size_t)(_p - _start + _overrun) * 8 - _bits; }
+
+        // bytes of the buffer that have not been loaded yet
+        size_t remaining() const { return _p < _end ? _end - _p : 0; }
+
+        // where the unread part of the buffer begins
+        const unsigned char *cursor() const { return _p; }
+
+        // continue reading from a new buffer whose first byte is the old cursor() byte,
+        // keeping the bits already loaded. Used when streaming input in chunks.
+        void rebase(const unsigned char *data, size_t size) {
+            _start = data;
+            _p = data;
+            _end = data + size;
+        }
+};
+
+#endif
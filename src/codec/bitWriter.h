@@ -0,0 +1,82 @@
+/***************************************************************************************************
+    File: bitWriter.h
+
+    Description:
+        A bit writer that packs variable-length codes into a 64-bit accumulator and stores
+        whole big-endian words into a caller-provided output buffer. Bits are written most
+        significant first, so the byte stream is the same as converting the '0'/'1' code
+        strings to bytes eight characters at a time. The caller sizes the buffer for the
+        worst case and drains it with size()/clear() between chunks of input.
+
+***************************************************************************************************/
+#ifndef BIT_WRITER_H
+#define BIT_WRITER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+inline void store_be64(unsigned char *p, uint64_t word) {
+    // store a word as 8 big-endian bytes
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    word = __builtin_bswap64(word);
+#endif
+    std::memcpy(p, &word, sizeof(word));
+}
+
+class bit_writer {
+    private:
+        unsigned char *_out;    // output buffer
+        size_t _pos;            // bytes stored in _out
+        uint64_t _acc;          // pending bits, left-aligned
+        unsigned _bits;         // number of pending bits, always < 64
+
+    public:
+        bit_writer(unsigned char *out) : _out(out), _pos(0), _acc(0), _bits(0) {}
+
+        // append the low length bits of code (1 <= length <= 64, no bits set above them)
+        inline void put(uint64_t code, unsigned length) {
+            unsigned room = 64 - _bits;
+            if (length < room) {
+                _acc |= code << (room - length);
+                _bits += length;
+                return;
+            }
+
+            // the accumulator is full: store it and keep the bits that did not fit
+            unsigned rest = length - room;
+            _acc |= code >> rest;
+            store_be64(_out + _pos, _acc);
+            _pos += 8;
+            _acc = rest ? code << (64 - rest) : 0;
+            _bits = rest;
+        }
+
+        // store the pending bits, padded with zeros up to a byte boundary
+        void flush() {
+            while (_bits > 0) {
+                _out[_pos++] = static_cast<unsigned char>(_acc >> 56);
+                _acc <<= 8;
+                _bits = _bits > 8 ? _bits - 8 : 0;
+            }
+        }
+
+        // number of whole bytes stored in the buffer
+        size_t size() const { return _pos; }
+
+        // number of bits written since the last clear(), including pending ones
+        uint64_t bit_count() const { return (uint64_t)_pos * 8 + _bits; }
+
+        // start filling the buffer from the beginning again; pending bits are kept
+        void clear() { _pos = 0; }
+
+        // continue in a new output buffer, keeping the pending bits. Used when the
+        // output space is handed over in pieces.
+        void rebase(unsigned char *out) {
+            _out = out;
+            _pos = 0;
+        }
+};
+
+#endif
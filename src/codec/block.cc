@@ -0,0 +1,257 @@
+/***************************************************************************************************
+    File: block.cc
+
+    Description:
+        Encoding and decoding of single blocks with canonical codes, or stored or run blocks
+        where codes do not pay.
+
+***************************************************************************************************/
+#include <algorithm>
+#include <cstring>
+#include "block.h"
+#include "bitReader.h"
+#include "bitWriter.h"
+#include "canonical.h"
+#include "decodeTable.h"
+#include "format.h"
+#include "histogram.h"
+#include "huffmanTree.h"
+
+namespace {
+
+size_t plan_uncoded(block_kind kind, const unsigned char *in, size_t size, block_plan & plan,
+                    unsigned char *head) {
+    // the header of a stored block or a run, and a plan that codes nothing
+
+    plan.kind = kind;
+    plan.max_length = 0;
+    plan.streams = 1;
+    plan.segment = size;
+    plan.bits = kind == BLOCK_STORED ? (uint64_t)size * 8 : 0;
+    store_le(head, size, 4);
+    store_le(head + 4, plan.bits, 4);
+    store_le(head + 8, 0, 2);
+    if (kind == BLOCK_STORED) return BLOCK_HEADER_SIZE;
+    head[BLOCK_HEADER_SIZE] = in[0];
+    return BLOCK_HEADER_SIZE + 1;
+}
+
+}
+
+size_t plan_block(const unsigned char *in, size_t size, unsigned max_bits, unsigned streams,
+                  unsigned min_gain, block_plan & plan, unsigned char *head) {
+    // every stream gets at least MIN_STREAM_SIZE bytes
+    size_t count = std::min<size_t>(std::max(streams, 1u), MAX_STREAMS);
+    count = std::max<size_t>(1, std::min(count, size / MIN_STREAM_SIZE));
+    size_t segment = (size + count - 1) / count;
+
+    // count every stream on its own, which gives both the histogram of the
+    // block and, once the code is known, where each stream starts
+    size_t counts[MAX_STREAMS][256];
+    size_t total[256] = {};
+    for (size_t s = 0; s < count; s++) {
+        std::fill(counts[s], counts[s] + 256, 0);
+        size_t first = std::min(size, s * segment);
+        count_bytes(in + first, std::min(size, first + segment) - first, counts[s]);
+        for (int k = 0; k < 256; k++) total[k] += counts[s][k];
+    }
+
+    // no code is shorter than the entropy, so when even that does not save
+    // min_gain percent the block is stored without building one
+    if (std::count(total, total + 256, 0) == 255) {
+        return plan_uncoded(BLOCK_RUN, in, size, plan, head);
+    }
+    double limit = (double)size * (100 - std::min(min_gain, 100u)) / 100;
+    if (entropy_bits(total) / 8 >= limit) return plan_uncoded(BLOCK_STORED, in, size, plan, head);
+
+    if (!make_code_lengths(total, plan.lengths, max_bits) ||
+        !make_canonical_codes(plan.lengths, plan.codes, 256)) {
+        return 0;
+    }
+    plan.kind = BLOCK_CODED;
+    plan.max_length = *std::max_element(plan.lengths, plan.lengths + 256);
+    plan.streams = (unsigned)count;
+    plan.segment = segment;
+
+    size_t table_size = write_code_lengths(plan.lengths, 256, head + BLOCK_HEADER_SIZE);
+    unsigned char *jump = head + BLOCK_HEADER_SIZE + table_size;
+    plan.bits = 0;
+    for (size_t s = 0; s < count; s++) {
+        if (s > 0) store_le(jump + (s - 1) * 4, plan.bits, 4);
+        for (int k = 0; k < 256; k++) plan.bits += counts[s][k] * plan.lengths[k];
+    }
+    size_t coded = table_size + (count - 1) * 4 + (plan.bits + 7) / 8;
+    if (coded >= limit) return plan_uncoded(BLOCK_STORED, in, size, plan, head);
+
+    store_le(head, size, 4);
+    store_le(head + 4, plan.bits, 4);
+    store_le(head + 8, table_size | (count - 1) << BLOCK_STREAMS_SHIFT, 2);
+    return BLOCK_HEADER_SIZE + table_size + (count - 1) * 4;
+}
+
+bool encode_block(const unsigned char *in, size_t size, unsigned max_bits, unsigned streams,
+                  unsigned min_gain, std::vector<unsigned char> & frame,
+                  size_t sync_interval, std::vector<uint32_t> *sync) {
+    // plan the block, then pack the codes after its tables; the exact size of
+    // the bits is known from the plan, and the writer may store up to 8 bytes
+    // past them
+
+    block_plan plan;
+    frame.resize(BLOCK_HEAD_BOUND);
+    size_t head_size = plan_block(in, size, max_bits, streams, min_gain, plan, frame.data());
+    if (head_size == 0) return false;
+    size_t step = sync_interval && sync ? sync_interval : size;
+    if (plan.kind != BLOCK_CODED) {
+        // a stored byte starts 8 bits after the one before, and a run has no bits
+        frame.resize(head_size);
+        if (plan.kind == BLOCK_STORED) frame.insert(frame.end(), in, in + size);
+        for (size_t start = step; start < size; start += step) {
+            sync->push_back(plan.kind == BLOCK_STORED ? (uint32_t)(start * 8) : 0);
+        }
+        return true;
+    }
+    frame.resize(head_size + plan.bits / 8 + 16);
+
+    // code the block one sync interval at a time, noting where each starts
+    bit_writer writer(frame.data() + head_size);
+    for (size_t start = 0; start < size; start += step) {
+        if (start > 0) sync->push_back((uint32_t)writer.bit_count());
+        size_t end = std::min(size, start + step);
+        for (size_t i = start; i < end; i++) {
+            writer.put(plan.codes[in[i]], plan.lengths[in[i]]);
+        }
+    }
+    writer.flush();
+    frame.resize(head_size + writer.size());
+    return true;
+}
+
+size_t block_uncompressed_size(const unsigned char *header) {
+    // first field of the header
+
+    return load_le(header, 4);
+}
+
+size_t block_frame_size(const unsigned char *header) {
+    // header, tables and the bits rounded up to whole bytes
+
+    return block_bits_offset(header) + (load_le(header + 4, 4) + 7) / 8;
+}
+
+unsigned block_streams(const unsigned char *header) {
+    // top bits of the table size field
+
+    return (unsigned)(load_le(header + 8, 2) >> BLOCK_STREAMS_SHIFT) + 1;
+}
+
+block_kind block_type(const unsigned char *header) {
+    // a table size field of 0, then the bit count tells the two uncoded kinds apart
+
+    if (load_le(header + 8, 2) != 0) return BLOCK_CODED;
+    return load_le(header + 4, 4) == 0 ? BLOCK_RUN : BLOCK_STORED;
+}
+
+size_t block_bits_offset(const unsigned char *header) {
+    // the bits follow the code length table and the jump table, or the byte value of a run
+
+    if (block_type(header) == BLOCK_RUN) return BLOCK_HEADER_SIZE + 1;
+    size_t table_size = load_le(header + 8, 2) & ((1 << BLOCK_STREAMS_SHIFT) - 1);
+    return BLOCK_HEADER_SIZE + table_size + (block_streams(header) - 1) * 4;
+}
+
+bool read_block_table(const unsigned char *frame, decode_table & table) {
+    // rebuild the canonical codes from the code lengths
+
+    unsigned char lengths[256];
+    uint64_t codes[256];
+    size_t table_size = load_le(frame + 8, 2) & ((1 << BLOCK_STREAMS_SHIFT) - 1);
+    return read_code_lengths(frame + BLOCK_HEADER_SIZE, table_size, lengths, 256) &&
+           make_canonical_codes(lengths, codes, 256) &&
+           table.build(codes, lengths, 256);
+}
+
+bool decode_block_bits(const unsigned char *frame, decode_table & table,
+                       const unsigned char *data, size_t size, unsigned skip,
+                       unsigned char *out, size_t n) {
+    // fill a run, copy stored bytes, or position the reader skip bits into data and decode
+
+    switch (block_type(frame)) {
+        case BLOCK_RUN:
+            std::memset(out, frame[BLOCK_HEADER_SIZE], n);
+            return true;
+        case BLOCK_STORED:
+            if (skip != 0 || size < n) return false;
+            std::memcpy(out, data, n);
+            return true;
+        case BLOCK_CODED:
+            break;
+    }
+    if (!read_block_table(frame, table)) return false;
+    bit_reader reader(data, size);
+    reader.refill();
+    reader.consume(skip);
+    return table.decode(reader, out, n);
+}
+
+bool decode_block(const unsigned char *frame, size_t frame_size, unsigned char *out) {
+    // with a table of its own
+
+    decode_table table;
+    return decode_block(frame, frame_size, out, table);
+}
+
+bool decode_block(const unsigned char *frame, size_t frame_size, unsigned char *out,
+                  decode_table & table) {
+    // rebuild the canonical codes from the table, decode every stream, and make
+    // sure the decoder used exactly the bits the encoder wrote
+
+    if (frame_size < BLOCK_HEADER_SIZE || block_frame_size(frame) != frame_size) return false;
+    size_t size = block_uncompressed_size(frame);
+    uint64_t bits = load_le(frame + 4, 4);
+
+    switch (block_type(frame)) {
+        case BLOCK_RUN:
+            std::memset(out, frame[BLOCK_HEADER_SIZE], size);
+            return true;
+        case BLOCK_STORED:
+            if (bits != (uint64_t)size * 8) return false;
+            std::memcpy(out, frame + BLOCK_HEADER_SIZE, size);
+            return true;
+        case BLOCK_CODED:
+            break;
+    }
+    if (!read_block_table(frame, table)) return false;
+
+    size_t offset = block_bits_offset(frame);
+    unsigned count = block_streams(frame);
+    if (count == 1) {
+        bit_reader reader(frame + offset, frame_size - offset);
+        return table.decode(reader, out, size) && reader.position() == bits;
+    }
+
+    // stream s covers the bytes [s * segment, (s + 1) * segment) of the block
+    // and the bits [starts[s], starts[s + 1])
+    const unsigned char *jump = frame + offset - (count - 1) * 4;
+    size_t segment = (size + count - 1) / count;
+    uint64_t starts[MAX_STREAMS + 1];
+    bit_reader readers[MAX_STREAMS];
+    unsigned char *outs[MAX_STREAMS];
+    size_t sizes[MAX_STREAMS];
+    starts[0] = 0;
+    starts[count] = bits;
+    for (unsigned s = 0; s < count; s++) {
+        if (s > 0) starts[s] = load_le(jump + (s - 1) * 4, 4);
+        if (starts[s] > bits || (s > 0 && starts[s] < starts[s - 1])) return false;
+        size_t first = std::min<size_t>(size, s * segment);
+        outs[s] = out + first;
+        sizes[s] = std::min<size_t>(size, first + segment) - first;
+        readers[s] = bit_reader(frame + offset + starts[s] / 8, frame_size - offset - starts[s] / 8);
+        readers[s].refill();
+        readers[s].consume(starts[s] % 8);
+    }
+    if (!table.decode(readers, outs, sizes, count)) return false;
+    for (unsigned s = 0; s < count; s++) {
+        if (readers[s].position() + starts[s] / 8 * 8 != starts[s + 1]) return false;
+    }
+    return true;
+}
@@ -0,0 +1,119 @@
+/***************************************************************************************************
+    File: block.h
+
+    Description:
+        Independently coded blocks of the block container format. Every block has its own
+        canonical code table, built from the histogram of the block alone, so blocks can be
+        compressed and decompressed in any order and adapt to data that changes over time.
+
+        Block frame:
+            uncompressed size (4 bytes) | bit count (4 bytes) | code length table size (2 bytes) |
+            code length table (see canonical.h) | [jump table] | bits, zero-padded to a byte
+
+        A block may be split into several streams: equal segments of the block (the last
+        one shorter) whose codes follow each other in the bits. The top 4 bits of the table
+        size field hold the number of streams minus one, and the jump table gives the bit
+        offset where every stream but the first starts (4 bytes each), so the decoder can
+        walk all the streams at once instead of along one long dependency chain.
+
+        A block that would not shrink by at least min_gain percent is stored instead, and
+        a block of a single byte value is run-length coded. Both have a table size field
+        of 0:
+            stored: uncompressed size | bit count = 8 * size | 0 (2 bytes) | the bytes
+            run:    uncompressed size | bit count = 0 | 0 (2 bytes) | the byte value
+        A stored block's bytes are its bits, 8 to a byte, so sync points and bit offsets
+        mean the same in every kind of block.
+
+***************************************************************************************************/
+#ifndef BLOCK_H
+#define BLOCK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "canonical.h"
+#include "decodeTable.h"
+
+const size_t BLOCK_HEADER_SIZE = 10;
+const size_t MIN_BLOCK_SIZE = 4 << 10;
+const size_t MAX_BLOCK_SIZE = 16 << 20;         // keeps the bit count within 4 bytes
+const size_t DEFAULT_BLOCK_SIZE = 1 << 20;
+const unsigned BLOCK_STREAMS_SHIFT = 12;        // position of the stream count in the table size
+const unsigned MAX_STREAMS = 16;
+const unsigned DEFAULT_STREAMS = 4;
+const size_t MIN_STREAM_SIZE = 1 << 10;         // shorter blocks get fewer streams
+const unsigned DEFAULT_MIN_GAIN = 1;            // percent a block must shrink by to be coded
+
+// largest header, code length table and jump table of a frame
+const size_t BLOCK_HEAD_BOUND = BLOCK_HEADER_SIZE + code_lengths_bound(256) + (MAX_STREAMS - 1) * 4;
+
+enum block_kind {
+    BLOCK_CODED,                // canonical Huffman codes
+    BLOCK_STORED,               // the bytes as they are
+    BLOCK_RUN                   // one byte value repeated
+};
+
+// the code of a block and how its bits are laid out
+struct block_plan {
+    block_kind kind;
+    unsigned char lengths[256];
+    uint64_t codes[256];
+    unsigned max_length;        // longest code
+    unsigned streams;           // number of streams
+    size_t segment;             // bytes per stream (the last one may have fewer)
+    uint64_t bits;              // bit count of the whole block
+};
+
+// count the size bytes of a block, build its code for up to streams streams, and write
+// the frame header, code length table and jump table (at most BLOCK_HEAD_BOUND bytes) to
+// head. The bits of the block are the codes of its bytes, in order (or the bytes
+// themselves in a stored block, and nothing in a run). Returns the size of what was
+// written to head, or 0 if the symbols do not fit in max_bits bits.
+size_t plan_block(const unsigned char *in, size_t size, unsigned max_bits, unsigned streams,
+                  unsigned min_gain, block_plan & plan, unsigned char *head);
+
+// compress size bytes (at most MAX_BLOCK_SIZE) into a block frame, replacing the contents
+// of frame. Codes are limited to max_bits bits when it is not 0, and the block is split
+// into up to streams streams; it is stored unless coding saves min_gain percent. With a
+// sync interval, the offset into the bits where every sync_interval-th byte starts is
+// appended to sync. Returns false if the symbols do not fit in max_bits bits.
+bool encode_block(const unsigned char *in, size_t size, unsigned max_bits, unsigned streams,
+                  unsigned min_gain, std::vector<unsigned char> & frame,
+                  size_t sync_interval = 0, std::vector<uint32_t> *sync = nullptr);
+
+// kind of the block whose header is at header
+block_kind block_type(const unsigned char *header);
+
+// uncompressed size of the block whose header is at header
+size_t block_uncompressed_size(const unsigned char *header);
+
+// size of the whole frame whose header is at header
+size_t block_frame_size(const unsigned char *header);
+
+// number of streams of the block whose header is at header
+unsigned block_streams(const unsigned char *header);
+
+// size of the header, code length table and jump table of the frame whose header is at
+// header; the bits of the block start there
+size_t block_bits_offset(const unsigned char *header);
+
+// build the decoder of a coded frame from its code length table (header and table must
+// be in memory). Returns false if the table is corrupt.
+bool read_block_table(const unsigned char *frame, decode_table & table);
+
+// decode n bytes from the bits of a block, starting skip (< 8) bits into data; the
+// header and table of the frame must be in memory at frame, and table is rebuilt for
+// coded blocks
+bool decode_block_bits(const unsigned char *frame, decode_table & table,
+                       const unsigned char *data, size_t size, unsigned skip,
+                       unsigned char *out, size_t n);
+
+// decompress a whole frame into out, which holds block_uncompressed_size bytes.
+// Returns false if the frame is corrupt.
+bool decode_block(const unsigned char *frame, size_t frame_size, unsigned char *out);
+
+// same, rebuilding the given table instead of a new one so that its memory is reused
+bool decode_block(const unsigned char *frame, size_t frame_size, unsigned char *out,
+                  decode_table & table);
+
+#endif
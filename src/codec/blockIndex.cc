@@ -0,0 +1,88 @@
+/***************************************************************************************************
+    File: blockIndex.cc
+
+    Description:
+        Writing and reading the block index and its trailer.
+
+***************************************************************************************************/
+#include "blockIndex.h"
+#include "format.h"
+
+namespace {
+
+const unsigned char INDEX_MAGIC[4] = {'H', 'Z', 'I', 'X'};
+
+}
+
+void write_block_index(const block_index & index, uint64_t index_offset,
+                       std::vector<unsigned char> & out) {
+    // entries in block order, each followed by its sync points, then the trailer
+    // pointing back at them
+
+    size_t start = out.size();
+    out.resize(start + (index.sync_interval ? 4 : 0) +
+               index.blocks.size() * BLOCK_INDEX_ENTRY_SIZE + index.sync.size() * 4 +
+               BLOCK_TRAILER_SIZE);
+    unsigned char *p = out.data() + start;
+    if (index.sync_interval) {
+        store_le(p, index.sync_interval, 4);
+        p += 4;
+    }
+    for (const block_index_entry & entry : index.blocks) {
+        store_le(p, entry.offset, 8);
+        store_le(p + 8, entry.bits, 4);
+        store_le(p + 12, entry.size, 4);
+        p += BLOCK_INDEX_ENTRY_SIZE;
+        for (size_t k = 0; k < index.sync_count(entry.size); k++, p += 4) {
+            store_le(p, index.sync[entry.first_sync + k], 4);
+        }
+    }
+    store_le(p, index_offset, 8);
+    store_le(p + 8, index.blocks.size(), 4);
+    for (int i = 0; i < 4; i++) p[12 + i] = INDEX_MAGIC[i];
+}
+
+bool read_block_trailer(const unsigned char *trailer, uint64_t file_size,
+                        uint64_t & index_offset, size_t & count) {
+    // check the magic and that the index fits between the header and the trailer
+
+    for (int i = 0; i < 4; i++) {
+        if (trailer[12 + i] != INDEX_MAGIC[i]) return false;
+    }
+    index_offset = load_le(trailer, 8);
+    count = load_le(trailer + 8, 4);
+    return index_offset >= BLOCKS_HEADER_SIZE &&
+           index_offset + (uint64_t)count * BLOCK_INDEX_ENTRY_SIZE + BLOCK_TRAILER_SIZE <= file_size;
+}
+
+bool read_block_index(const unsigned char *in, size_t size, size_t count, bool with_sync,
+                      block_index & index) {
+    // inverse of write_block_index, without the trailer
+
+    const unsigned char *end = in + size;
+    index.sync_interval = 0;
+    index.sync.clear();
+    if (with_sync) {
+        if (size < 4) return false;
+        index.sync_interval = load_le(in, 4);
+        in += 4;
+        if (index.sync_interval == 0) return false;
+    }
+
+    index.blocks.resize(count);
+    for (block_index_entry & entry : index.blocks) {
+        if ((size_t)(end - in) < BLOCK_INDEX_ENTRY_SIZE) return false;
+        entry.offset = load_le(in, 8);
+        entry.bits = load_le(in + 8, 4);
+        entry.size = load_le(in + 12, 4);
+        entry.first_sync = index.sync.size();
+        in += BLOCK_INDEX_ENTRY_SIZE;
+
+        size_t sync_count = index.sync_count(entry.size);
+        if ((size_t)(end - in) / 4 < sync_count) return false;
+        for (size_t k = 0; k < sync_count; k++, in += 4) {
+            index.sync.push_back(load_le(in, 4));
+        }
+    }
+    return in == end;
+}
@@ -0,0 +1,63 @@
+/***************************************************************************************************
+    File: blockIndex.h
+
+    Description:
+        The block index of the block format. It follows the end marker and lists where every
+        block frame starts, so a reader with random access to the compressed file can find
+        and decode any block without reading the ones before it. Optionally, it also holds
+        sync points inside the blocks: the bit offset of every sync_interval-th byte of a
+        block, so a slice of a block can be decoded without decoding the block from the start.
+
+        Index:    [sync interval (4 bytes), with BLOCKS_FLAG_SYNC]
+                  then for every block:
+                      frame offset from the start of the file (8 bytes) | bit count (4 bytes) |
+                      uncompressed size (4 bytes)
+                      [with BLOCKS_FLAG_SYNC: (size - 1) / sync interval sync points, each the
+                       offset (4 bytes) into the bits of the block where byte k * sync interval
+                       starts, for k = 1, 2, ...]
+        Trailer:  index offset (8 bytes) | block count (4 bytes) | "HZIX"
+        The trailer is the last BLOCK_TRAILER_SIZE bytes of the file.
+
+***************************************************************************************************/
+#ifndef BLOCK_INDEX_H
+#define BLOCK_INDEX_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+const size_t BLOCK_INDEX_ENTRY_SIZE = 16;
+const size_t BLOCK_TRAILER_SIZE = 16;
+
+struct block_index_entry {
+    uint64_t offset;                // where the frame starts in the compressed file
+    uint64_t bits;                  // bit count of the frame
+    uint64_t size;                  // uncompressed size of the block
+    size_t first_sync;              // position of the block's first sync point in sync
+};
+
+struct block_index {
+    std::vector<block_index_entry> blocks;
+    size_t sync_interval = 0;       // bytes between sync points, 0 when there are none
+    std::vector<uint32_t> sync;     // bit offsets of the sync points, block after block
+
+    // number of sync points inside a block of the given size
+    size_t sync_count(uint64_t size) const {
+        return sync_interval && size ? (size - 1) / sync_interval : 0;
+    }
+};
+
+// append the index and the trailer; index_offset is where the index will start
+void write_block_index(const block_index & index, uint64_t index_offset,
+                       std::vector<unsigned char> & out);
+
+// read the trailer at the end of a file of file_size bytes. Returns false if it is not one.
+bool read_block_trailer(const unsigned char *trailer, uint64_t file_size,
+                        uint64_t & index_offset, size_t & count);
+
+// read an index of count blocks from the size bytes between the index offset and the
+// trailer. Returns false if they do not hold exactly such an index.
+bool read_block_index(const unsigned char *in, size_t size, size_t count, bool with_sync,
+                      block_index & index);
+
+#endif
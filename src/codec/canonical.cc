@@ -0,0 +1,73 @@
+/***************************************************************************************************
+    File: canonical.cc
+
+    Description:
+        Canonical code assignment and the run-length coding of code lengths.
+
+***************************************************************************************************/
+#include "canonical.h"
+
+bool make_canonical_codes(const unsigned char *lengths, uint64_t *codes, size_t num_symbols) {
+    // count the codes of each length, find the first code of each length,
+    // then hand out consecutive codes to the symbols in order
+
+    uint64_t count[CANONICAL_MAX_BITS + 1] = {};
+    for (size_t s = 0; s < num_symbols; s++) {
+        if (lengths[s] > CANONICAL_MAX_BITS) return false;
+        count[lengths[s]]++;
+    }
+    count[0] = 0;
+
+    uint64_t next[CANONICAL_MAX_BITS + 1] = {};
+    uint64_t code = 0;
+    for (unsigned length = 1; length <= CANONICAL_MAX_BITS; length++) {
+        code = (code + count[length - 1]) << 1;
+        next[length] = code;
+
+        // the codes of this length must fit in length bits
+        if (count[length] > ((uint64_t)1 << length) - code) return false;
+    }
+
+    for (size_t s = 0; s < num_symbols; s++) {
+        codes[s] = lengths[s] ? next[lengths[s]]++ : 0;
+    }
+    return true;
+}
+
+size_t write_code_lengths(const unsigned char *lengths, size_t num_symbols, unsigned char *out) {
+    // a used symbol takes one byte, a run of unused symbols takes one byte per 128
+
+    size_t size = 0;
+    for (size_t s = 0; s < num_symbols; ) {
+        if (lengths[s] != 0) {
+            out[size++] = lengths[s++];
+            continue;
+        }
+        size_t run = 0;
+        while (s < num_symbols && lengths[s] == 0 && run < 128) {
+            run++;
+            s++;
+        }
+        out[size++] = static_cast<unsigned char>(0x80 | (run - 1));
+    }
+    return size;
+}
+
+bool read_code_lengths(const unsigned char *in, size_t size, unsigned char *lengths,
+                       size_t num_symbols) {
+    // expand the runs back into one length per symbol
+
+    size_t s = 0;
+    for (size_t i = 0; i < size; i++) {
+        if (in[i] & 0x80) {
+            size_t run = (in[i] & 0x7f) + 1;
+            if (run > num_symbols - s) return false;
+            for (size_t k = 0; k < run; k++) lengths[s++] = 0;
+        }
+        else {
+            if (s == num_symbols) return false;
+            lengths[s++] = in[i];
+        }
+    }
+    return s == num_symbols;
+}
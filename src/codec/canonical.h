@@ -0,0 +1,37 @@
+/***************************************************************************************************
+    File: canonical.h
+
+    Description:
+        Canonical Huffman codes. Only the code length of each symbol is stored; both sides then
+        assign codes the same way: shorter codes first, and symbols of equal length in
+        increasing order, each code being the previous one plus one. The code lengths are
+        written as one byte per used symbol with runs of unused symbols collapsed:
+            1 .. 127        the code length of the next symbol
+            0x80 | (n - 1)  the next n (1 <= n <= 128) symbols are unused
+
+***************************************************************************************************/
+#ifndef CANONICAL_H
+#define CANONICAL_H
+
+#include <cstdint>
+#include <cstddef>
+
+// longest code a canonical table may hold
+const unsigned CANONICAL_MAX_BITS = 63;
+
+// assign canonical codes from code lengths. Returns false if a length is too long or
+// the lengths describe more codes than fit (the lengths of a Huffman tree always fit).
+bool make_canonical_codes(const unsigned char *lengths, uint64_t *codes, size_t num_symbols);
+
+// largest number of bytes write_code_lengths produces for num_symbols symbols
+constexpr size_t code_lengths_bound(size_t num_symbols) { return num_symbols; }
+
+// run-length code the lengths into out, return the number of bytes written
+size_t write_code_lengths(const unsigned char *lengths, size_t num_symbols, unsigned char *out);
+
+// inverse of write_code_lengths: fill lengths from exactly size bytes of in.
+// Returns false if the bytes do not describe exactly num_symbols lengths.
+bool read_code_lengths(const unsigned char *in, size_t size, unsigned char *lengths,
+                       size_t num_symbols);
+
+#endif
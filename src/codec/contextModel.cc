@@ -0,0 +1,413 @@
+/***************************************************************************************************
+    File: contextModel.cc
+
+    Description:
+        Counting contexts, clustering them into groups, and coding bytes with the code of
+        their context.
+
+***************************************************************************************************/
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "contextModel.h"
+#include "format.h"
+#include "huffmanTree.h"
+
+namespace {
+
+// counts below this take their logarithm from a table. Larger ones are shifted into the
+// top half of it and interpolated between two entries, which is accurate to about 1e-8
+// bits: the costs of clusters are compared by their differences, which are small next
+// to the costs themselves in a large file.
+const unsigned LOG_TABLE_BITS = 12;
+const size_t LOG_TABLE_SIZE = size_t(1) << LOG_TABLE_BITS;
+
+struct log_table {
+    double values[LOG_TABLE_SIZE + 1];
+    double scales[64];                      // 2^-shift, to take the fraction without dividing
+
+    log_table() {
+        values[0] = 0;
+        for (size_t n = 1; n <= LOG_TABLE_SIZE; n++) values[n] = std::log2((double)n);
+        for (int shift = 0; shift < 64; shift++) scales[shift] = std::ldexp(1.0, -shift);
+    }
+    double operator()(size_t n) const {
+        if (n < LOG_TABLE_SIZE) return values[n];
+        unsigned shift = 64 - __builtin_clzll(n) - LOG_TABLE_BITS;
+        size_t i = n >> shift;
+        double fraction = (double)(n & ((size_t(1) << shift) - 1)) * scales[shift];
+        return shift + values[i] + (values[i + 1] - values[i]) * fraction;
+    }
+};
+
+const log_table log2_of;
+
+// contexts that start as clusters of their own; rarer ones join the closest of them, so
+// clustering takes a bounded number of cost estimates however many contexts occur
+const size_t SEED_CLUSTERS = 64;
+
+// the bytes of a cluster of contexts
+struct cluster {
+    size_t counts[256];
+    size_t total;
+    std::vector<unsigned char> symbols;     // byte values with a count, in increasing order
+    double cost;
+};
+
+double symbol_bits(size_t n, double log_total) {
+    // what n occurrences of a byte out of 2^log_total cost: their share of the entropy,
+    // but at least one bit each
+
+    return n * std::max(1.0, log_total - log2_of(n));
+}
+
+double table_bits(size_t used) {
+    // the size field and the code length table of used byte values, which are about as
+    // many bytes again for the runs of unused ones between them
+
+    return 16 + 8 * (double)std::min<size_t>(2 * used + 1, code_lengths_bound(256));
+}
+
+double cost(const cluster & c) {
+    double log_total = log2_of(c.total);
+    double bits = 0;
+    for (unsigned char s : c.symbols) bits += symbol_bits(c.counts[s], log_total);
+    return bits + table_bits(c.symbols.size());
+}
+
+double merged_cost(const cluster & a, const cluster & b) {
+    // the cost of a and b as one cluster, without building it
+
+    double log_total = log2_of(a.total + b.total);
+    double bits = 0;
+    size_t used = a.symbols.size();
+    for (unsigned char s : a.symbols) bits += symbol_bits(a.counts[s] + b.counts[s], log_total);
+    for (unsigned char s : b.symbols) {
+        if (a.counts[s] != 0) continue;
+        bits += symbol_bits(b.counts[s], log_total);
+        used++;
+    }
+    return bits + table_bits(used);
+}
+
+void merge(cluster & into, const cluster & from) {
+    for (unsigned char s : from.symbols) into.counts[s] += from.counts[s];
+    into.total += from.total;
+    into.symbols.clear();
+    for (int s = 0; s < 256; s++) {
+        if (into.counts[s]) into.symbols.push_back((unsigned char)s);
+    }
+    into.cost = cost(into);
+}
+
+void cluster_contexts(const size_t *counts, unsigned max_groups, unsigned char *group_of,
+                      std::vector<cluster> & clusters) {
+    // Greedy agglomerative clustering: the SEED_CLUSTERS most frequent contexts start as
+    // clusters, and every other context that occurs joins the one it adds the fewest bits
+    // to. Then the pair whose merge adds the fewest bits is merged while that saves bits
+    // or there are too many clusters. Each cluster remembers its best partner, so a step
+    // scans the clusters once and only rescans the rows a merge changed.
+
+    std::vector<int> contexts;
+    std::vector<size_t> totals(256, 0);
+    for (int p = 0; p < 256; p++) {
+        for (int s = 0; s < 256; s++) totals[p] += counts[p * 256 + s];
+        if (totals[p] > 0) contexts.push_back(p);
+    }
+    std::stable_sort(contexts.begin(), contexts.end(),
+                     [&](int p, int q) { return totals[p] > totals[q]; });
+
+    std::vector<int> owner(256, -1);      // cluster of each context
+    for (int p : contexts) {
+        cluster c;
+        std::copy(counts + p * 256, counts + p * 256 + 256, c.counts);
+        c.total = totals[p];
+        for (int s = 0; s < 256; s++) {
+            if (c.counts[s]) c.symbols.push_back((unsigned char)s);
+        }
+        c.cost = cost(c);
+        if (clusters.size() < SEED_CLUSTERS) {
+            owner[p] = (int)clusters.size();
+            clusters.push_back(std::move(c));
+            continue;
+        }
+        size_t best = 0;
+        double lowest = std::numeric_limits<double>::infinity();
+        for (size_t k = 0; k < clusters.size(); k++) {
+            double added = merged_cost(clusters[k], c) - clusters[k].cost;
+            if (added < lowest) {
+                best = k;
+                lowest = added;
+            }
+        }
+        merge(clusters[best], c);
+        owner[p] = (int)best;
+    }
+
+    size_t n = clusters.size();
+    std::vector<bool> alive(n, true);
+    std::vector<double> delta(n * n, 0);        // added bits of merging two clusters
+    std::vector<size_t> best(n, 0);             // cheapest partner of each cluster
+    const double NONE = std::numeric_limits<double>::infinity();
+    auto pair_delta = [&](size_t a, size_t b) {
+        return merged_cost(clusters[a], clusters[b]) - clusters[a].cost - clusters[b].cost;
+    };
+    auto rescan = [&](size_t a) {
+        best[a] = a;
+        for (size_t b = 0; b < n; b++) {
+            if (b != a && alive[b] && (best[a] == a || delta[a * n + b] < delta[a * n + best[a]])) {
+                best[a] = b;
+            }
+        }
+    };
+    for (size_t a = 0; a < n; a++) {
+        for (size_t b = a + 1; b < n; b++) delta[a * n + b] = delta[b * n + a] = pair_delta(a, b);
+    }
+    for (size_t a = 0; a < n; a++) rescan(a);
+
+    for (size_t left = n; left > 1; left--) {
+        size_t a = n;
+        double lowest = NONE;
+        for (size_t k = 0; k < n; k++) {
+            if (alive[k] && best[k] != k && delta[k * n + best[k]] < lowest) {
+                a = k;
+                lowest = delta[k * n + best[k]];
+            }
+        }
+        if (lowest >= 0 && left <= max_groups) break;
+
+        // merge b into a and bring the rows that involve either up to date
+        size_t b = best[a];
+        merge(clusters[a], clusters[b]);
+        alive[b] = false;
+        for (int p = 0; p < 256; p++) {
+            if (owner[p] == (int)b) owner[p] = (int)a;
+        }
+        for (size_t k = 0; k < n; k++) {
+            if (k == a || !alive[k]) continue;
+            delta[a * n + k] = delta[k * n + a] = pair_delta(a, k);
+        }
+        rescan(a);
+        for (size_t k = 0; k < n; k++) {
+            if (k == a || !alive[k]) continue;
+            if (best[k] == a || best[k] == b) rescan(k);
+            else if (delta[k * n + a] < delta[k * n + best[k]]) best[k] = a;
+        }
+    }
+
+    // number the clusters that are left; contexts that never occur go to the first group
+    std::vector<int> number(n, -1);
+    std::vector<cluster> kept;
+    for (size_t k = 0; k < n; k++) {
+        if (!alive[k]) continue;
+        number[k] = (int)kept.size();
+        kept.push_back(std::move(clusters[k]));
+    }
+    clusters.swap(kept);
+    for (int p = 0; p < 256; p++) group_of[p] = owner[p] < 0 ? 0 : number[owner[p]];
+}
+
+int single_byte(const context_code & code) {
+    // the byte every group codes, if each codes only that one
+
+    int single = -1;
+    for (const context_group & group : code.groups) {
+        int used = 0;
+        for (int c = 0; c < 256; c++) {
+            if (group.lengths[c] == 0) continue;
+            if (used++ > 0 || (single >= 0 && single != c)) return -1;
+            single = c;
+        }
+    }
+    return single;
+}
+
+}
+
+void count_contexts(const unsigned char *data, size_t size, size_t *counts) {
+    // the context is part of the index, so unlike count_bytes a repeated byte does not
+    // keep hitting one counter unless it follows the same byte each time
+
+    unsigned previous = 0;
+    for (size_t i = 0; i < size; i++) {
+        counts[previous << 8 | data[i]]++;
+        previous = data[i];
+    }
+}
+
+bool build_context_code(const size_t *counts, unsigned max_groups, unsigned max_bits,
+                        context_code & code) {
+    std::vector<cluster> clusters;
+    max_groups = std::min(std::max(max_groups, 1u), MAX_CONTEXT_GROUPS);
+    cluster_contexts(counts, max_groups, code.group_of, clusters);
+    if (clusters.empty()) return false;
+
+    code.groups.resize(clusters.size());
+    code.max_length = 0;
+    for (size_t g = 0; g < clusters.size(); g++) {
+        context_group & group = code.groups[g];
+        if (!make_code_lengths(clusters[g].counts, group.lengths, max_bits) ||
+            !make_canonical_codes(group.lengths, group.codes, 256)) {
+            return false;
+        }
+        code.max_length = std::max<unsigned>(code.max_length,
+                                             *std::max_element(group.lengths, group.lengths + 256));
+    }
+    code.single = single_byte(code);
+    return true;
+}
+
+size_t write_context_header(const context_code & code, uint64_t file_size, unsigned char *out) {
+    out[0] = FORMAT_MAGIC[0];
+    out[1] = FORMAT_MAGIC[1];
+    out[2] = FORMAT_CONTEXT;
+    store_le(out + 3, file_size, 8);
+    out[11] = (unsigned char)code.groups.size();
+
+    // the group numbers, most significant bit first
+    unsigned bits = context_map_bits(code.groups.size());
+    size_t size = CONTEXT_HEADER_SIZE + context_map_size(code.groups.size());
+    std::fill(out + CONTEXT_HEADER_SIZE, out + size, 0);
+    for (unsigned p = 0, at = 0; bits > 0 && p < 256; p++) {
+        for (unsigned b = bits; b-- > 0; at++) {
+            if (code.group_of[p] >> b & 1) out[CONTEXT_HEADER_SIZE + at / 8] |= 0x80 >> at % 8;
+        }
+    }
+    for (const context_group & group : code.groups) {
+        size_t table_size = write_code_lengths(group.lengths, 256, out + size + 2);
+        store_le(out + size, table_size, 2);
+        size += 2 + table_size;
+    }
+    return size;
+}
+
+size_t read_context_header(const unsigned char *in, size_t size, context_code & code,
+                           uint64_t & file_size) {
+    // every context must name a group that exists, and every table must hold a code
+
+    if (size < CONTEXT_HEADER_SIZE || in[0] != FORMAT_MAGIC[0] ||
+        in[1] != FORMAT_MAGIC[1] || in[2] != FORMAT_CONTEXT) {
+        return 0;
+    }
+    file_size = load_le(in + 3, 8);
+    unsigned groups = in[11];
+    if (groups == 0 || groups > MAX_CONTEXT_GROUPS ||
+        size - CONTEXT_HEADER_SIZE < context_map_size(groups)) {
+        return 0;
+    }
+    unsigned bits = context_map_bits(groups);
+    for (unsigned p = 0, at = 0; p < 256; p++) {
+        unsigned group = 0;
+        for (unsigned b = 0; b < bits; b++, at++) {
+            group = group << 1 | (in[CONTEXT_HEADER_SIZE + at / 8] >> (7 - at % 8) & 1);
+        }
+        if (group >= groups) return 0;
+        code.group_of[p] = (unsigned char)group;
+    }
+
+    code.groups.resize(groups);
+    code.max_length = 0;
+    size_t offset = CONTEXT_HEADER_SIZE + context_map_size(groups);
+    for (context_group & group : code.groups) {
+        if (size - offset < 2) return 0;
+        size_t table_size = load_le(in + offset, 2);
+        offset += 2;
+        if (table_size > size - offset ||
+            !read_code_lengths(in + offset, table_size, group.lengths, 256) ||
+            !make_canonical_codes(group.lengths, group.codes, 256)) {
+            return 0;
+        }
+        offset += table_size;
+        code.max_length = std::max<unsigned>(code.max_length,
+                                             *std::max_element(group.lengths, group.lengths + 256));
+    }
+    code.single = single_byte(code);
+    return offset;
+}
+
+void encode_contexts(const context_code & code, const unsigned char *in, size_t size,
+                     unsigned char previous, bit_writer & out) {
+    // the group of every context is looked up once, so a byte costs one more load than
+    // with a single code
+
+    const context_group *group_of[256];
+    for (int p = 0; p < 256; p++) group_of[p] = &code.groups[code.group_of[p]];
+    const context_group *group = group_of[previous];
+    for (size_t i = 0; i < size; i++) {
+        unsigned char c = in[i];
+        out.put(group->codes[c], group->lengths[c]);
+        group = group_of[c];
+    }
+}
+
+bool context_decoder::build(const context_code & code) {
+    // Fill the root table of every group with an entry for each bit pattern that starts
+    // with a code of at most _root_bits bits, and leave the others at 0. The entry of a
+    // code also holds the group of the context it starts, so that the next lookup does
+    // not wait for another load.
+
+    size_t groups = code.groups.size();
+    _tables.resize(groups);
+    _max_length = code.max_length;
+    _root_bits = std::min(ROOT_BITS, _max_length);
+    _roots.assign(groups << _root_bits, 0);
+    std::copy(code.group_of, code.group_of + 256, _group_of);
+    for (size_t g = 0; g < groups; g++) {
+        const context_group & group = code.groups[g];
+        if (!_tables[g].build(group.codes, group.lengths, 256)) return false;
+        uint32_t *root = &_roots[g << _root_bits];
+        for (int s = 0; s < 256; s++) {
+            unsigned length = group.lengths[s];
+            if (length == 0 || length > _root_bits) continue;
+            uint32_t entry = (uint32_t)_group_of[s] << GROUP_SHIFT | s << SYMBOL_SHIFT | length;
+            size_t start = (size_t)group.codes[s] << (_root_bits - length);
+            std::fill(root + start, root + start + ((size_t)1 << (_root_bits - length)), entry);
+        }
+    }
+    return true;
+}
+
+bool context_decoder::decode(bit_reader & in, unsigned char *out, size_t n,
+                             unsigned char & previous) const {
+    // Every byte picks the table of the next one, so bytes are decoded one at a time,
+    // each with a single probe of the root tables unless its code is longer than the
+    // root. A refill leaves at least 56 bits, enough for two codes of up to 28 bits.
+
+    const uint32_t *roots = _roots.data();
+    const unsigned root_bits = _root_bits;
+    unsigned group = _group_of[previous];
+    unsigned c = previous;
+    auto next = [&]() {
+        uint32_t entry = roots[group << root_bits | in.peek(root_bits)];
+        unsigned length = entry & LENGTH_MASK;
+        if (length == 0) {
+            long symbol = _tables[group].decode(in);
+            if (symbol < 0) return false;
+            c = (unsigned)symbol;
+            group = _group_of[c];
+            return true;
+        }
+        in.consume(length);
+        c = entry >> SYMBOL_SHIFT & 0xff;
+        group = entry >> GROUP_SHIFT;
+        return true;
+    };
+
+    size_t i = 0;
+    if (_max_length <= 28) {
+        for (; i + 2 <= n; i += 2) {
+            in.refill();
+            if (!next()) return false;
+            out[i] = (unsigned char)c;
+            if (!next()) return false;
+            out[i + 1] = (unsigned char)c;
+        }
+    }
+    for (; i < n; i++) {
+        in.refill();
+        if (!next()) return false;
+        out[i] = (unsigned char)c;
+    }
+    previous = (unsigned char)c;
+    return true;
+}
@@ -0,0 +1,128 @@
+/***************************************************************************************************
+    File: contextModel.h
+
+    Description:
+        Order-1 context modelling for the context format (version 4, see format.h). Every byte
+        is coded with the code of its context, the byte before it (0 for the first byte of a
+        file), so text and structured data whose bytes depend on their predecessor code below
+        their order-0 entropy.
+
+        A code per context would cost up to 256 code length tables, so contexts are clustered
+        into groups that share a code: starting from a group for each of the most frequent
+        contexts, which the other contexts join, the two groups whose merge costs the fewest
+        bits are merged until no merge saves bits and there are at most max_groups groups.
+        The cost of a group is an estimate of its coded bits (no fewer than one per byte, as
+        with any Huffman code) plus its code length table. With one group the code is the
+        order-0 code of the file.
+
+        A file of one repeated byte has codes of that byte alone, and no bits: its decoder
+        fills the output with the byte (files that were written with a bit per byte still
+        decode, as the bits are not read).
+
+        The decoder switches tables on every byte, by the byte it has just decoded, so it
+        cannot decode several bytes per probe. Instead the root tables of all groups sit in
+        one array, and each entry names the group of the context its symbol starts, so the
+        next probe only waits for the one before it. Codes longer than the root go to a
+        decode_table per group. The encoder looks up the group of every byte the same way.
+
+***************************************************************************************************/
+#ifndef CONTEXT_MODEL_H
+#define CONTEXT_MODEL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "bitReader.h"
+#include "bitWriter.h"
+#include "canonical.h"
+#include "decodeTable.h"
+
+const size_t CONTEXT_HEADER_SIZE = 12;          // magic, version, file size and group count
+const unsigned MAX_CONTEXT_GROUPS = 64;
+const unsigned DEFAULT_CONTEXT_GROUPS = 16;
+
+// bits of a group number in the context map of a number of groups, none for one group
+constexpr unsigned context_map_bits(size_t groups) {
+    return groups <= 1 ? 0 : 1 + context_map_bits((groups + 1) / 2);
+}
+
+// bytes of the context map: a group number for each of the 256 contexts
+constexpr size_t context_map_size(size_t groups) { return 32 * context_map_bits(groups); }
+
+// largest header, context map and code length tables of the context format
+const size_t CONTEXT_HEAD_BOUND = CONTEXT_HEADER_SIZE + context_map_size(MAX_CONTEXT_GROUPS) +
+                                  MAX_CONTEXT_GROUPS * (2 + code_lengths_bound(256));
+
+// the code shared by a group of contexts
+struct context_group {
+    unsigned char lengths[256];
+    uint64_t codes[256];
+};
+
+// the codes of a file in the context format
+struct context_code {
+    unsigned char group_of[256];            // group of each context
+    std::vector<context_group> groups;
+    unsigned max_length;                    // longest code of any group
+    int single;                             // the only byte of the file, or -1
+};
+
+// add to counts[256 * 256] the number of times each byte follows each context: the count
+// of byte c after byte p is counts[p * 256 + c]. The first byte counts as following 0.
+void count_contexts(const unsigned char *data, size_t size, size_t *counts);
+
+// cluster the contexts counted in counts (at least one byte) into at most max_groups
+// groups (1 to MAX_CONTEXT_GROUPS) and build their codes, limited to max_bits bits when it
+// is not 0. Returns false if the bytes of a group do not fit in max_bits bits.
+bool build_context_code(const size_t *counts, unsigned max_groups, unsigned max_bits,
+                        context_code & code);
+
+// write the header of the context format (at most CONTEXT_HEAD_BOUND bytes) to out and
+// return its size
+size_t write_context_header(const context_code & code, uint64_t file_size, unsigned char *out);
+
+// read the header of the context format from the size bytes at in. Returns its size, or 0
+// if they do not start with a whole, valid header.
+size_t read_context_header(const unsigned char *in, size_t size, context_code & code,
+                           uint64_t & file_size);
+
+// append the codes of size bytes to out. previous is the byte before in, or 0 at the
+// start of the file, so a file can be coded in pieces.
+void encode_contexts(const context_code & code, const unsigned char *in, size_t size,
+                     unsigned char previous, bit_writer & out);
+
+class context_decoder {
+    private:
+        static constexpr unsigned ROOT_BITS = 11;       // width of the root table of a group
+
+        // a root entry is (group of the next context << GROUP_SHIFT) | (symbol <<
+        // SYMBOL_SHIFT) | code length, or 0 for bits that start a longer code
+        static constexpr unsigned SYMBOL_SHIFT = 5;
+        static constexpr unsigned GROUP_SHIFT = 13;
+        static constexpr uint32_t LENGTH_MASK = 0x1f;
+
+        std::vector<uint32_t> _roots;           // root tables of all groups, one after another
+        unsigned _root_bits;                    // width actually used by the root tables
+        std::vector<decode_table> _tables;      // whole tables, for the longer codes
+        unsigned char _group_of[256];
+        unsigned _max_length;
+
+    public:
+        context_decoder() : _root_bits(0), _group_of(), _max_length(0) {}
+
+        context_decoder(const context_decoder &) = delete;
+        context_decoder & operator=(const context_decoder &) = delete;
+
+        // build the tables of every group of code. Returns false if a group has no code.
+        // The tables are rebuilt in place, reusing their memory.
+        bool build(const context_code & code);
+
+        // decode n bytes into out; previous is the context of the first one, and is left
+        // at the last one decoded. Returns false on a corrupt stream.
+        bool decode(bit_reader & in, unsigned char *out, size_t n, unsigned char & previous) const;
+
+        // length of the longest code, which bounds the bits a byte takes
+        unsigned max_length() const { return _max_length; }
+};
+
+#endif
@@ -0,0 +1,299 @@
+/***************************************************************************************************
+    File: decodeTable.cc
+
+    Description:
+        Construction of the multi-level lookup tables and the decoding loops that use them.
+
+***************************************************************************************************/
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "decodeTable.h"
+
+bool decode_table::build(const uint64_t *codes, const unsigned char *lengths, size_t num_symbols) {
+    // collect the used codes and size the root table to the longest of them
+
+    _list.clear();
+    unsigned max_length = 0;
+    for (size_t s = 0; s < num_symbols; s++) {
+        if (lengths[s] == 0) continue;
+        if (lengths[s] > MAX_BITS) return false;
+        _list.push_back({codes[s], lengths[s], (uint32_t)s});
+        max_length = std::max<unsigned>(max_length, lengths[s]);
+    }
+    if (_list.empty()) return false;
+
+    _max_length = max_length;
+    _root_bits = std::min(ROOT_BITS, max_length);
+    _entries.assign((size_t)1 << _root_bits, LINK);
+    _fill(0, _root_bits, 0, _list.data(), _list.data() + _list.size());
+
+    // a code of length len stands for a symbol of probability about 2^-len, so
+    // this is the average code length the encoder expected
+    double average = 0;
+    for (const code_word & w : _list) average += std::ldexp((double)w.length, -(int)w.length);
+    if (average <= MULTI_MAX_AVERAGE && num_symbols <= 256) _build_multi();
+    else _multi.clear();
+    return true;
+}
+
+void decode_table::_build_multi() {
+    // _first lists the single code each MULTI_BITS-bit pattern starts with, as
+    // (symbol << 8) | length, 0 when that code is longer; the multi-symbol entry
+    // of a pattern then chains as many of those codes as fit in it
+
+    const size_t size = (size_t)1 << MULTI_BITS;
+    _first.assign(size, 0);
+    for (const code_word & w : _list) {
+        if (w.length > MULTI_BITS) continue;
+        size_t start = (size_t)w.code << (MULTI_BITS - w.length);
+        size_t count = (size_t)1 << (MULTI_BITS - w.length);
+        for (size_t i = 0; i < count; i++) _first[start + i] = (w.symbol << 8) | w.length;
+    }
+
+    _multi.assign(size, 0);
+    for (size_t x = 0; x < size; x++) {
+        unsigned char symbols[4] = {};
+        unsigned count = 0, used = 0;
+        while (count < 4) {
+            uint32_t entry = _first[(x << used) & (size - 1)];
+            unsigned length = entry & 0xff;
+            if (length == 0 || length > MULTI_BITS - used) break;
+            symbols[count++] = (unsigned char)(entry >> 8);
+            used += length;
+        }
+        uint32_t word;
+        std::memcpy(&word, symbols, 4);
+        _multi[x] = word | (uint64_t)count << 32 | (uint64_t)used << 40;
+    }
+}
+
+void decode_table::_fill(size_t base, unsigned width, unsigned consumed,
+                         code_word *begin, code_word *end) {
+    // codes that end inside this table are replicated over every index they prefix;
+    // longer codes are grouped by the index they pass through and get their own sub-table
+
+    code_word *longer = std::partition(begin, end, [&](const code_word & w) {
+        return w.length - consumed <= width;
+    });
+    for (code_word *w = begin; w < longer; w++) {
+        unsigned rest = w->length - consumed;
+        uint64_t bits = w->code & (((uint64_t)1 << rest) - 1);
+        size_t first = (size_t)bits << (width - rest);
+        size_t count = (size_t)1 << (width - rest);
+        for (size_t i = 0; i < count; i++) {
+            _entries[base + first + i] = (w->symbol << 8) | rest;
+        }
+    }
+
+    // the index a long code passes through is the width bits after the consumed prefix
+    auto index_of = [&](const code_word & w) {
+        unsigned rest = w.length - consumed;
+        return (size_t)((w.code >> (rest - width)) & (((uint64_t)1 << width) - 1));
+    };
+    std::sort(longer, end, [&](const code_word & a, const code_word & b) {
+        return index_of(a) < index_of(b);
+    });
+
+    for (code_word *group = longer; group < end; ) {
+        size_t index = index_of(*group);
+        unsigned max_length = 0;
+        code_word *group_end = group;
+        for (; group_end < end && index_of(*group_end) == index; group_end++) {
+            max_length = std::max(max_length, group_end->length);
+        }
+
+        unsigned sub_width = std::min(ROOT_BITS, max_length - consumed - width);
+        size_t offset = _entries.size();
+        _entries.resize(offset + ((size_t)1 << sub_width), LINK);
+        _entries[base + index] = (uint32_t)(offset << 8) | LINK | sub_width;
+        _fill(offset, sub_width, consumed + width, group, group_end);
+        group = group_end;
+    }
+}
+
+long decode_table::_decode_long(bit_reader & in, uint32_t entry) const {
+    // follow links until a symbol entry, refilling between levels since a long code
+    // may not fit in what is left of the bit buffer
+
+    unsigned width = _root_bits;
+    while (entry & LINK) {
+        in.consume(width);
+        in.refill();
+        width = entry & 0x7f;
+        if (width == 0) return -1;
+        entry = _entries[(entry >> 8) + in.peek(width)];
+    }
+    in.consume(entry & 0x7f);
+    return entry >> 8;
+}
+
+bool decode_table::_decode_single(bit_reader & in, unsigned char *out, size_t n) const {
+    // after a refill at least 56 bits are buffered, enough for four root-level codes
+
+    const uint32_t *table = _entries.data();
+    const unsigned root_bits = _root_bits;
+    size_t i = 0;
+    while (i < n) {
+        in.refill();
+        for (int k = 0; k < 4 && i < n; k++) {
+            uint32_t entry = table[in.peek(root_bits)];
+            if (entry & LINK) {
+                long symbol = _decode_long(in, entry);
+                if (symbol < 0) return false;
+                out[i++] = (unsigned char)symbol;
+                break;
+            }
+            in.consume(entry & 0x7f);
+            out[i++] = (unsigned char)(entry >> 8);
+        }
+    }
+    return true;
+}
+
+bool decode_table::_decode_multi(bit_reader & in, unsigned char *out, size_t n) const {
+    // every probe stores four bytes and keeps the ones it decoded, so it needs
+    // room for a whole store; four probes of at most MULTI_BITS bits fit in a
+    // refill. The last bytes are decoded one at a time.
+
+    const uint64_t *multi = _multi.data();
+    size_t i = 0;
+    while (i + 16 <= n) {
+        in.refill();
+        for (int k = 0; k < 4; k++) {
+            uint64_t entry = multi[in.peek(MULTI_BITS)];
+            unsigned count = (entry >> 32) & 0xff;
+            if (count == 0) {
+                long symbol = decode(in);
+                if (symbol < 0) return false;
+                out[i++] = (unsigned char)symbol;
+                continue;
+            }
+            uint32_t word = (uint32_t)entry;
+            std::memcpy(out + i, &word, 4);
+            i += count;
+            in.consume((unsigned)(entry >> 40));
+        }
+    }
+    return _decode_single(in, out + i, n - i);
+}
+
+template <unsigned STREAMS>
+bool decode_table::_decode_group(bit_reader *in, unsigned char *const *out, const size_t *n) const {
+    // the streams do not depend on each other, so the core can work on the
+    // lookups of one stream while waiting for another. Like the single stream
+    // loop, a refill leaves room for four root-level codes; a long code refills
+    // on its own and still leaves room for the rest of the round. The readers
+    // are copied to locals so that the byte stores cannot alias them.
+
+    const uint32_t *table = _entries.data();
+    const unsigned root_bits = _root_bits;
+    bit_reader reader[STREAMS];
+    unsigned char *dest[STREAMS];
+    size_t common = n[0];
+    for (unsigned s = 0; s < STREAMS; s++) {
+        reader[s] = in[s];
+        dest[s] = out[s];
+        common = std::min(common, n[s]);
+    }
+
+    bool ok = true;
+    size_t i = 0;
+    for (; ok && i + 4 <= common; i += 4) {
+        for (unsigned s = 0; s < STREAMS; s++) reader[s].refill();
+        for (int k = 0; k < 4; k++) {
+            for (unsigned s = 0; s < STREAMS; s++) {
+                uint32_t entry = table[reader[s].peek(root_bits)];
+                if (entry & LINK) {
+                    bit_reader slow = reader[s];
+                    long symbol = _decode_long(slow, entry);
+                    reader[s] = slow;
+                    ok &= symbol >= 0;
+                    dest[s][i + k] = (unsigned char)symbol;
+                    continue;
+                }
+                reader[s].consume(entry & 0x7f);
+                dest[s][i + k] = (unsigned char)(entry >> 8);
+            }
+        }
+    }
+
+    // finish the longer streams one at a time
+    for (unsigned s = 0; s < STREAMS; s++) {
+        in[s] = reader[s];
+        if (ok) ok = _decode_single(in[s], out[s] + i, n[s] - i);
+    }
+    return ok;
+}
+
+template <unsigned STREAMS>
+bool decode_table::_decode_group_multi(bit_reader *in, unsigned char *const *out,
+                                       const size_t *n) const {
+    // the multi-symbol loop on several streams at once; each stream moves
+    // ahead by however many symbols its probes held
+
+    const uint64_t *multi = _multi.data();
+    bit_reader reader[STREAMS];
+    unsigned char *dest[STREAMS];
+    size_t done[STREAMS];
+    for (unsigned s = 0; s < STREAMS; s++) {
+        reader[s] = in[s];
+        dest[s] = out[s];
+        done[s] = 0;
+    }
+
+    bool ok = true;
+    while (ok) {
+        bool room = true;
+        for (unsigned s = 0; s < STREAMS; s++) room &= done[s] + 16 <= n[s];
+        if (!room) break;
+
+        for (unsigned s = 0; s < STREAMS; s++) reader[s].refill();
+        for (int k = 0; k < 4; k++) {
+            for (unsigned s = 0; s < STREAMS; s++) {
+                uint64_t entry = multi[reader[s].peek(MULTI_BITS)];
+                unsigned count = (entry >> 32) & 0xff;
+                if (count == 0) {
+                    bit_reader slow = reader[s];
+                    long symbol = decode(slow);
+                    reader[s] = slow;
+                    ok &= symbol >= 0;
+                    dest[s][done[s]++] = (unsigned char)symbol;
+                    continue;
+                }
+                uint32_t word = (uint32_t)entry;
+                std::memcpy(dest[s] + done[s], &word, 4);
+                done[s] += count;
+                reader[s].consume((unsigned)(entry >> 40));
+            }
+        }
+    }
+
+    for (unsigned s = 0; s < STREAMS; s++) {
+        in[s] = reader[s];
+        if (ok) ok = _decode_multi(in[s], out[s] + done[s], n[s] - done[s]);
+    }
+    return ok;
+}
+
+bool decode_table::decode(bit_reader *in, unsigned char *const *out, const size_t *n,
+                          unsigned count) const {
+    // groups of four streams, then whatever is left
+
+    bool multi = !_multi.empty();
+    unsigned s = 0;
+    for (; s + 4 <= count; s += 4) {
+        if (!(multi ? _decode_group_multi<4>(in + s, out + s, n + s)
+                    : _decode_group<4>(in + s, out + s, n + s))) {
+            return false;
+        }
+    }
+    switch (count - s) {
+        case 3: return multi ? _decode_group_multi<3>(in + s, out + s, n + s)
+                             : _decode_group<3>(in + s, out + s, n + s);
+        case 2: return multi ? _decode_group_multi<2>(in + s, out + s, n + s)
+                             : _decode_group<2>(in + s, out + s, n + s);
+        case 1: return decode(in[s], out[s], n[s]);
+        default: return true;
+    }
+}
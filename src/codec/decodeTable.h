@@ -0,0 +1,117 @@
+/***************************************************************************************************
+    File: decodeTable.h
+
+    Description:
+        A table-driven Huffman decoder. Instead of walking the tree one bit at a time, the
+        decoder looks at the next ROOT_BITS bits of the stream and finds the symbol and its code
+        length with a single probe. Codes longer than ROOT_BITS share a root entry that links
+        to a second-level table indexed by the following bits (and so on for very long codes),
+        so the tables stay small even for deep trees.
+
+        Each entry is a 32-bit word:
+            symbol entry:  (symbol << 8) | code length
+            link entry:    (offset of the sub-table << 8) | LINK | width of the sub-table
+        A link of width 0 marks a bit pattern that no code starts with.
+
+        When the codes are short on average, a second table indexed by the next MULTI_BITS
+        bits lists every whole code those bits hold (up to four), so one probe and one 4-byte
+        store emit several symbols. Its 64-bit entries are:
+            symbols (4 bytes, in output order) | count (1 byte) | bits consumed (1 byte)
+        A count of 0 means the first code is too long, and the decoder falls back to the
+        first table for that symbol. Only byte alphabets get this table; symbols of larger
+        alphabets are decoded one at a time with decode(bit_reader &).
+
+***************************************************************************************************/
+#ifndef DECODE_TABLE_H
+#define DECODE_TABLE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "bitReader.h"
+
+class decode_table {
+    public:
+        static constexpr unsigned ROOT_BITS = 11;   // width of the first-level table
+        static constexpr unsigned MAX_BITS = 64;    // longest code the decoder accepts
+        static constexpr unsigned MULTI_BITS = 11;  // width of the multi-symbol table
+
+        // the multi-symbol table is used when the expected code length, sum(len * 2^-len),
+        // is at most this many bits
+        static constexpr double MULTI_MAX_AVERAGE = 5.0;
+
+    private:
+        static constexpr uint32_t LINK = 0x80;      // entry points to a sub-table
+
+        std::vector<uint32_t> _entries;         // root table followed by all sub-tables
+        unsigned _root_bits;                    // width actually used by the root table
+        unsigned _max_length;                   // longest code
+        std::vector<uint64_t> _multi;           // multi-symbol table, empty when not used
+
+        struct code_word {
+            uint64_t code;
+            unsigned length;
+            uint32_t symbol;
+        };
+
+        // scratch space of build, kept so that rebuilding the table does not allocate
+        std::vector<code_word> _list;
+        std::vector<uint32_t> _first;
+
+        // fill the table at base (width bits) with the codes in [begin, end), all of which
+        // start with the same consumed bits; reorders the codes
+        void _fill(size_t base, unsigned width, unsigned consumed,
+                   code_word *begin, code_word *end);
+
+        // finish decoding a symbol whose root entry is a link, -1 if no code matches
+        long _decode_long(bit_reader & in, uint32_t entry) const;
+
+        // build _multi from the codes in _list that fit in MULTI_BITS bits
+        void _build_multi();
+
+        // decode n bytes one symbol per probe, or several with the multi-symbol table
+        bool _decode_single(bit_reader & in, unsigned char *out, size_t n) const;
+        bool _decode_multi(bit_reader & in, unsigned char *out, size_t n) const;
+
+        // decode STREAMS streams side by side while each has four symbols left
+        template <unsigned STREAMS>
+        bool _decode_group(bit_reader *in, unsigned char *const *out, const size_t *n) const;
+
+        // same with the multi-symbol table, while each stream has room for four full probes
+        template <unsigned STREAMS>
+        bool _decode_group_multi(bit_reader *in, unsigned char *const *out, const size_t *n) const;
+
+    public:
+        decode_table() : _root_bits(0), _max_length(0) {}
+
+        // build the tables from per-symbol codes (code bits are the low lengths[s] bits of
+        // codes[s]); symbols with length 0 are unused. Returns false if there is no code or
+        // a code is longer than MAX_BITS. A table can be rebuilt any number of times, and
+        // reuses its memory.
+        bool build(const uint64_t *codes, const unsigned char *lengths, size_t num_symbols);
+
+        // decode one symbol, -1 if the bits do not match any code
+        inline long decode(bit_reader & in) const {
+            uint32_t entry = _entries[in.peek(_root_bits)];
+            if (entry & LINK) return _decode_long(in, entry);
+            in.consume(entry & 0x7f);
+            return entry >> 8;
+        }
+
+        // length of the longest code, which bounds the bits a symbol takes
+        unsigned max_length() const { return _max_length; }
+
+        // true when decoding emits several symbols per probe
+        bool multi_symbol() const { return !_multi.empty(); }
+
+        // decode n bytes into out. Returns false on a corrupt stream.
+        bool decode(bit_reader & in, unsigned char *out, size_t n) const {
+            return _multi.empty() ? _decode_single(in, out, n) : _decode_multi(in, out, n);
+        }
+
+        // decode n[s] bytes from in[s] into out[s] for each of count streams, interleaving
+        // up to four streams so their lookups overlap. Returns false on a corrupt stream.
+        bool decode(bit_reader *in, unsigned char *const *out, const size_t *n, unsigned count) const;
+};
+
+#endif
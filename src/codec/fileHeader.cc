@@ -0,0 +1,87 @@
+/***************************************************************************************************
+    File: fileHeader.cc
+
+    Description:
+        Writing and reading the headers of the original and canonical formats.
+
+***************************************************************************************************/
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include "fileHeader.h"
+#include "format.h"
+
+size_t write_legacy_header(const huffman_tree & tree, uint64_t file_size, unsigned char *out) {
+    std::string digits = std::to_string(file_size);
+    std::memcpy(out, digits.data(), digits.size());
+    return digits.size() + write_tree(tree, out + digits.size());
+}
+
+size_t write_canonical_header(const unsigned char *lengths, uint64_t file_size,
+                              unsigned char *out) {
+    // magic, version, the original file size and the run-length coded code lengths
+
+    out[0] = FORMAT_MAGIC[0];
+    out[1] = FORMAT_MAGIC[1];
+    out[2] = FORMAT_CANONICAL;
+    store_le(out + 3, file_size, 8);
+    size_t table_size = write_code_lengths(lengths, 256, out + CANONICAL_HEADER_SIZE);
+    store_le(out + 11, table_size, 2);
+    return CANONICAL_HEADER_SIZE + table_size;
+}
+
+namespace {
+
+size_t read_legacy_header(const unsigned char *in, size_t size, file_code & code) {
+    // the file size in decimal, then the tree; a tree of one leaf has an empty code
+
+    const unsigned char *p = in;
+    const unsigned char *end = in + size;
+    code.file_size = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; p++) {
+        if (code.file_size > (UINT64_MAX - 9) / 10) return 0;
+        code.file_size = code.file_size * 10 + (*p - '0');
+    }
+    huffman_tree tree;
+    if (p == in || !read_tree(p, end, tree)) return 0;
+    std::fill(code.lengths, code.lengths + 256, 0);
+    if (tree.is_leaf(tree.root)) {
+        code.single = tree.nodes[tree.root].character;
+        code.max_length = 0;
+        return p - in;
+    }
+    if (!make_codes(tree, code.codes, code.lengths)) return 0;
+    code.single = -1;
+    code.max_length = *std::max_element(code.lengths, code.lengths + 256);
+    return p - in;
+}
+
+size_t read_canonical_header(const unsigned char *in, size_t size, file_code & code) {
+    if (size < CANONICAL_HEADER_SIZE) return 0;
+    size_t table_size = load_le(in + 11, 2);
+    if (table_size > size - CANONICAL_HEADER_SIZE ||
+        !read_code_lengths(in + CANONICAL_HEADER_SIZE, table_size, code.lengths, 256) ||
+        !make_canonical_codes(code.lengths, code.codes, 256)) {
+        return 0;
+    }
+    // a table of one code has no bits, whatever length it gives the code
+    code.file_size = load_le(in + 3, 8);
+    int used = 0;
+    for (int c = 0; c < 256; c++) {
+        if (code.lengths[c] > 0 && used++ == 0) code.single = c;
+    }
+    if (used != 1) code.single = -1;
+    code.max_length = *std::max_element(code.lengths, code.lengths + 256);
+    return CANONICAL_HEADER_SIZE + table_size;
+}
+
+}
+
+size_t read_file_header(const unsigned char *in, size_t size, file_code & code) {
+    // the original format starts with a digit, the canonical one with its magic
+
+    if (size == 0) return 0;
+    if (in[0] != FORMAT_MAGIC[0]) return read_legacy_header(in, size, code);
+    if (size < 3 || in[1] != FORMAT_MAGIC[1] || in[2] != FORMAT_CANONICAL) return 0;
+    return read_canonical_header(in, size, code);
+}
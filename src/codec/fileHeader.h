@@ -0,0 +1,50 @@
+/***************************************************************************************************
+    File: fileHeader.h
+
+    Description:
+        Headers of the two formats that code a whole file with one code: the original format
+        (the file size in decimal and the tree in its I/L form, see huffmanTree.h) and the
+        canonical format (version 1, see format.h). Reading one builds the codes it stands
+        for, so every decoder of these formats starts from the same file_code, and a code
+        of a single character is recognized in one place.
+
+***************************************************************************************************/
+#ifndef FILE_HEADER_H
+#define FILE_HEADER_H
+
+#include <cstddef>
+#include <cstdint>
+#include "canonical.h"
+#include "huffmanTree.h"
+
+// largest header of the original format: 20 digits of file size and a whole tree
+const size_t LEGACY_HEAD_BOUND = 20 + TREE_FORM_BOUND;
+
+// the canonical header without its code length table, and with the largest one
+const size_t CANONICAL_HEADER_SIZE = 13;
+const size_t CANONICAL_HEAD_BOUND = CANONICAL_HEADER_SIZE + code_lengths_bound(256);
+
+// the code of a file in the original or canonical format
+struct file_code {
+    uint64_t file_size;
+    unsigned char lengths[256];
+    uint64_t codes[256];
+    unsigned max_length;            // longest code
+    int single;                     // the character of a one-leaf tree or a one-code table,
+                                    // which have no bits, or -1
+};
+
+// write the header of the original format, with the tree of the code, to out (at most
+// LEGACY_HEAD_BOUND bytes) and return its size
+size_t write_legacy_header(const huffman_tree & tree, uint64_t file_size, unsigned char *out);
+
+// write the header of the canonical format, with the code lengths of the code, to out (at
+// most CANONICAL_HEAD_BOUND bytes) and return its size
+size_t write_canonical_header(const unsigned char *lengths, uint64_t file_size,
+                              unsigned char *out);
+
+// read the header of the original or canonical format from the size bytes at in and build
+// its codes. Returns its size, or 0 if they do not start with a whole, valid header.
+size_t read_file_header(const unsigned char *in, size_t size, file_code & code);
+
+#endif
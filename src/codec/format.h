@@ -0,0 +1,112 @@
+/***************************************************************************************************
+    File: format.h
+
+    Description:
+        Layout of the versioned compressed formats. The original format starts with the file
+        size written as decimal digits, so a file that starts with the magic bytes "HZ"
+        followed by a version byte can always be told apart from it. Multi-byte integers in
+        the versioned headers are little-endian.
+
+        Version 1 (canonical):
+            "HZ" 1 | file size (8 bytes) | code length table size (2 bytes) |
+            code length table (see canonical.h) | bits, zero-padded to a byte
+        A table with a single code stands for a file of one repeated byte, which has no
+        bits: older files give that byte one bit each, which are not read.
+
+        Version 2 (blocks):
+            "HZ" 2 | flags (1 byte) | block size (4 bytes) |
+            block frames (see block.h) | end marker: 4 zero bytes
+        The input is cut into blocks of the block size (the last one may be shorter), and
+        each block is coded on its own. With BLOCKS_FLAG_INDEX set, the end marker is
+        followed by an index of the blocks (see blockIndex.h).
+
+        Version 3 (shared table):
+            "HZ" 3 | table ID (4 bytes) | file size (varint) | bits, zero-padded to a byte
+        The codes come from a table file (see sharedTable.h) that the decoder must be given;
+        the header only names it. A varint holds 7 bits per byte, least significant first,
+        with the top bit set on every byte but the last.
+
+        Version 4 (contexts):
+            "HZ" 4 | file size (8 bytes) | group count (1 byte) | context map |
+            per group: code length table size (2 bytes) | code length table | bits,
+            zero-padded to a byte
+        Every byte is coded with the code of the group its previous byte maps to in the
+        context map; the first byte with that of byte 0 (see contextModel.h). The map
+        holds the group of each of the 256 byte values in the fewest bits that fit the
+        largest group number, most significant bit first, so a single group has none.
+        As in version 1, when every group has a single code, all of them for the same
+        byte, there are no bits.
+
+        Version 5 (symbols):
+            "HZ" 5 | symbol width (1 byte: 2 or 4) | symbol count (varint) |
+            symbol code table (see symbolCode.h) | bits, zero-padded to a byte
+        The data is an array of 16-bit or 32-bit symbols, each below 65536, coded with
+        one code over the symbols themselves rather than over their bytes. Decoded as
+        bytes, every symbol is written in its width, little-endian. As in version 1, a
+        table of a single symbol has no bits.
+
+***************************************************************************************************/
+#ifndef FORMAT_H
+#define FORMAT_H
+
+#include <cstdint>
+#include <cstddef>
+
+const unsigned char FORMAT_MAGIC[2] = {'H', 'Z'};
+
+enum format_version {
+    FORMAT_LEGACY = 0,          // decimal size and I/L tree, no magic
+    FORMAT_CANONICAL = 1,       // code lengths of canonical codes
+    FORMAT_BLOCKS = 2,          // independently coded blocks
+    FORMAT_TABLE = 3,           // codes of a shared table file
+    FORMAT_CONTEXT = 4,         // codes chosen by the previous byte
+    FORMAT_SYMBOLS = 5          // codes of 16-bit or 32-bit symbols
+};
+
+const size_t BLOCKS_HEADER_SIZE = 8;
+const unsigned char BLOCKS_FLAG_INDEX = 1;     // a block index follows the end marker
+const unsigned char BLOCKS_FLAG_SYNC = 2;      // the block index holds sync points
+
+const size_t TABLE_HEADER_SIZE = 7;             // without the varint file size
+const size_t VARINT_BOUND = 10;                 // bytes of the longest 64-bit varint
+const size_t SYMBOLS_HEADER_SIZE = 4;           // without the varint symbol count
+
+inline void store_le(unsigned char *p, uint64_t value, size_t bytes) {
+    // store the low bytes of value, least significant first
+
+    for (size_t i = 0; i < bytes; i++, value >>= 8) {
+        p[i] = static_cast<unsigned char>(value);
+    }
+}
+
+inline uint64_t load_le(const unsigned char *p, size_t bytes) {
+    // load a little-endian integer of the given width
+
+    uint64_t value = 0;
+    for (size_t i = bytes; i > 0; i--) {
+        value = (value << 8) | p[i - 1];
+    }
+    return value;
+}
+
+inline size_t store_varint(unsigned char *p, uint64_t value) {
+    // store value 7 bits at a time and return how many bytes that took
+
+    size_t n = 0;
+    for (; value >= 0x80; value >>= 7) p[n++] = static_cast<unsigned char>(value | 0x80);
+    p[n++] = static_cast<unsigned char>(value);
+    return n;
+}
+
+inline size_t load_varint(const unsigned char *p, const unsigned char *end, uint64_t & value) {
+    // load a varint from [p, end) and return its size, or 0 if it is cut short or too long
+
+    value = 0;
+    for (size_t n = 0; n < VARINT_BOUND && p + n < end; n++) {
+        value |= (uint64_t)(p[n] & 0x7f) << (7 * n);
+        if (!(p[n] & 0x80)) return n + 1;
+    }
+    return 0;
+}
+
+#endif
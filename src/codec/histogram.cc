@@ -0,0 +1,127 @@
+/***************************************************************************************************
+    File: histogram.cc
+
+    Description:
+        Multi-table byte counting.
+
+***************************************************************************************************/
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "histogram.h"
+
+namespace {
+
+// bytes counted before the 32-bit tables are folded into the totals, so that
+// no counter can overflow
+const size_t CHUNK_SIZE = size_t(1) << 30;
+
+// slices of count_bytes_parallel are at least this long; shorter inputs are
+// not worth waking the workers for
+const size_t MIN_SLICE = size_t(1) << 20;
+
+inline uint64_t load64(const unsigned char *p) {
+    uint64_t word;
+    std::memcpy(&word, p, 8);
+    return word;
+}
+
+void count_chunk(const unsigned char *data, size_t size, size_t *counts) {
+    // four tables; consecutive bytes of a word go to different tables, so a
+    // run of one byte value updates four counters in turn instead of one
+    uint32_t tables[4][256] = {};
+    const unsigned char *p = data;
+    const unsigned char *end = data + size;
+
+    // two words per round, loaded before any counter is touched
+    while (end - p >= 16) {
+        uint64_t a = load64(p);
+        uint64_t b = load64(p + 8);
+        p += 16;
+        for (int shift = 0; shift < 64; shift += 32) {
+            tables[0][(unsigned char)(a >> shift)]++;
+            tables[1][(unsigned char)(a >> (shift + 8))]++;
+            tables[2][(unsigned char)(a >> (shift + 16))]++;
+            tables[3][(unsigned char)(a >> (shift + 24))]++;
+            tables[0][(unsigned char)(b >> shift)]++;
+            tables[1][(unsigned char)(b >> (shift + 8))]++;
+            tables[2][(unsigned char)(b >> (shift + 16))]++;
+            tables[3][(unsigned char)(b >> (shift + 24))]++;
+        }
+    }
+    while (p < end) tables[0][*p++]++;
+
+    for (int k = 0; k < 256; k++) {
+        counts[k] += (size_t)tables[0][k] + tables[1][k] + tables[2][k] + tables[3][k];
+    }
+}
+
+}
+
+void count_bytes(const unsigned char *data, size_t size, size_t *counts) {
+    while (size > 0) {
+        size_t n = size < CHUNK_SIZE ? size : CHUNK_SIZE;
+        count_chunk(data, n, counts);
+        data += n;
+        size -= n;
+    }
+}
+
+void count_bytes_parallel(const unsigned char *data, size_t size, size_t *counts,
+                          thread_pool & pool) {
+    size_t slices = size / MIN_SLICE;
+    if (slices > pool.size()) slices = pool.size();
+    if (slices <= 1) {
+        count_bytes(data, size, counts);
+        return;
+    }
+
+    // each slice gets its own totals, summed once every slice is done
+    std::vector<size_t> partial(slices * 256, 0);
+    size_t slice_size = (size + slices - 1) / slices;
+    pool.run(slices, [&](size_t i) {
+        size_t first = i * slice_size;
+        size_t n = first < size ? std::min(slice_size, size - first) : 0;
+        count_bytes(data + first, n, &partial[i * 256]);
+    });
+    for (size_t i = 0; i < slices; i++) {
+        for (int k = 0; k < 256; k++) counts[k] += partial[i * 256 + k];
+    }
+}
+
+size_t count_sample(const unsigned char *data, size_t size, size_t sample_size, size_t *counts) {
+    // the prefix catches headers and the chunks the rest of the file; a chunk is
+    // large enough to read in one go from disk, but small enough that even a small
+    // sample is spread over at least MIN_SAMPLE_CHUNKS of them
+
+    if (size <= sample_size + sample_size / 2) {
+        count_bytes(data, size, counts);
+        return size;
+    }
+    size_t prefix = sample_size / 4;
+    size_t rest = sample_size - prefix;
+    size_t chunks = std::max(MIN_SAMPLE_CHUNKS, (rest + SAMPLE_CHUNK_SIZE - 1) / SAMPLE_CHUNK_SIZE);
+    chunks = std::max<size_t>(1, std::min(chunks, rest));
+    size_t chunk = rest / chunks;
+    size_t stride = (size - prefix - chunk) / std::max<size_t>(1, chunks - 1);
+    count_bytes(data, prefix, counts);
+    for (size_t i = 0; i < chunks; i++) {
+        count_bytes(data + prefix + i * stride, chunk, counts);
+    }
+    return prefix + chunks * chunk;
+}
+
+double entropy_bits(const size_t *counts) {
+    // sum of count * log2(total / count) = total * log2(total) - sum of count * log2(count)
+
+    size_t total = 0;
+    double sum = 0;
+    for (int k = 0; k < 256; k++) {
+        if (counts[k] == 0) continue;
+        total += counts[k];
+        sum += counts[k] * std::log2((double)counts[k]);
+    }
+    return total ? std::max(0.0, total * std::log2((double)total) - sum) : 0;
+}
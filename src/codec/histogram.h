@@ -0,0 +1,41 @@
+/***************************************************************************************************
+    File: histogram.h
+
+    Description:
+        Byte histograms of memory buffers. A single table of counters stalls whenever the
+        same byte comes back soon, since each increment has to wait for the store of the
+        previous one; count_bytes spreads the bytes over four tables of 32-bit counters
+        that are incremented independently and summed at the end. count_bytes_parallel
+        splits a large buffer into slices counted on a thread pool. count_sample counts only
+        part of a buffer, so that a code can be built before a large file is read through.
+        entropy_bits tells from a histogram how small any code of its bytes can get.
+
+***************************************************************************************************/
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <cstddef>
+#include "threadPool.h"
+
+// add the number of occurrences of every byte of data[0..size) to counts[256]
+void count_bytes(const unsigned char *data, size_t size, size_t *counts);
+
+// same as count_bytes, with slices of the buffer counted on every thread of pool
+void count_bytes_parallel(const unsigned char *data, size_t size, size_t *counts,
+                          thread_pool & pool);
+
+// largest chunk count_sample takes after the prefix, and the fewest chunks it takes
+const size_t SAMPLE_CHUNK_SIZE = 64 << 10;
+const size_t MIN_SAMPLE_CHUNKS = 16;
+
+// add to counts[256] the bytes of a sample of at most sample_size bytes of data: the
+// first quarter of it from the start, the rest in chunks spread evenly over the
+// remainder. All of data is counted when it is not much larger than the sample. Returns
+// how many bytes were counted.
+size_t count_sample(const unsigned char *data, size_t size, size_t sample_size, size_t *counts);
+
+// the order-0 entropy of the bytes counted in counts[256], in bits: no Huffman code of
+// them is shorter
+double entropy_bits(const size_t *counts);
+
+#endif
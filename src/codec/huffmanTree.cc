@@ -0,0 +1,186 @@
+/***************************************************************************************************
+    File: huffmanTree.cc
+
+    Description:
+        Building Huffman trees with a priority-queue-based min-heap and reading codes and code
+        lengths off them. Nodes live in the array of the tree, so nothing here allocates
+        per node.
+
+***************************************************************************************************/
+#include <algorithm>
+#include "huffmanTree.h"
+#include "canonical.h"
+#include "packageMerge.h"
+#include "sortedLengths.h"
+#include "../queue/minHeap.h"
+#include "../queue/priorityQueue.h"
+
+namespace {
+
+// a subtree waiting in the queue: its weight, the character that breaks ties (the
+// leftmost one) and its root in the tree
+struct subtree {
+    size_t count;
+    int character;
+    uint16_t node;
+};
+
+struct subtree_cmp {
+    // true if there are fewer letter a than letter b in a given string,
+    // or if letter a come before letter b in the aphabet
+
+    bool operator()(const subtree & a, const subtree & b) const {
+        if (a.count != b.count) return a.count < b.count;
+        return a.character < b.character;
+    }
+};
+
+}
+
+uint16_t huffman_tree::add_leaf(unsigned char character) {
+    if (size == TREE_MAX_NODES) return TREE_NONE;
+    nodes[size] = {TREE_NONE, TREE_NONE, character};
+    return size++;
+}
+
+uint16_t huffman_tree::add_internal(uint16_t left, uint16_t right) {
+    if (size == TREE_MAX_NODES) return TREE_NONE;
+    nodes[size] = {left, right, 0};
+    return size++;
+}
+
+template <typename queue_type>
+void build_tree(const size_t *counts, huffman_tree & tree) {
+    // Assemble a queue of Huffman trees into one Huffman tree
+
+    tree.clear();
+
+    // Add a node for each character found in the original file into a priority queue.
+    // No two subtrees compare equal, so the tree does not depend on the kind of queue
+    // or on how it is arranged inside.
+    subtree leaves[256];
+    size_t n = 0;
+    for (int i = 0; i < 256; i++) {
+        if (counts[i] != 0) {
+            leaves[n++] = {counts[i], i, tree.add_leaf(i)};
+        }
+    }
+    queue_type queue(leaves, leaves + n);
+
+    // Tree-building algorithm:
+    // Repeatedly use the priority queue to retrieve two top nodes
+    // and combine them to make a tree. Then reinserting the tree into
+    // the queue until queue size is 1.
+    while (queue.size() > 1) {
+        subtree left_h = queue.take();
+        subtree right_h = queue.take();
+        queue.add({left_h.count + right_h.count, left_h.character,
+                   tree.add_internal(left_h.node, right_h.node)});
+    }
+
+    // The last node inside the queue is the Huffman tree.
+    tree.root = queue.front().node;
+}
+
+void make_tree(const size_t *counts, huffman_tree & tree, tree_builder builder) {
+    if (builder == TREE_BUILDER_LIST) build_tree<priority_queue<subtree, subtree_cmp>>(counts, tree);
+    else build_tree<min_heap<subtree, subtree_cmp>>(counts, tree);
+}
+
+namespace {
+
+uint16_t read_subtree(const unsigned char *& in, const unsigned char *end, unsigned depth,
+                      huffman_tree & tree) {
+    // a tree of 256 leaves is at most 255 levels deep
+
+    if (in == end || depth > 255) return TREE_NONE;
+    unsigned char v = *in++;
+    if (v == 'L') {
+        if (in == end) return TREE_NONE;
+        return tree.add_leaf(*in++);
+    }
+    if (v != 'I') return TREE_NONE;
+    uint16_t left = read_subtree(in, end, depth + 1, tree);
+    uint16_t right = left != TREE_NONE ? read_subtree(in, end, depth + 1, tree) : TREE_NONE;
+    if (right == TREE_NONE) return TREE_NONE;
+    return tree.add_internal(left, right);
+}
+
+size_t write_subtree(const huffman_tree & tree, uint16_t k, unsigned char *out) {
+    // "L" and the character of a leaf; "I" and both subtrees of an internal node, every
+    // internal node having two since a Huffman tree is a full tree
+
+    const huffman_tree::node & n = tree.nodes[k];
+    if (n.left == TREE_NONE) {
+        out[0] = 'L';
+        out[1] = (unsigned char)n.character;
+        return 2;
+    }
+    out[0] = 'I';
+    size_t size = 1 + write_subtree(tree, n.left, out + 1);
+    return size + write_subtree(tree, n.right, out + size);
+}
+
+bool make_subtree_codes(const huffman_tree & tree, uint16_t k, uint64_t *codes,
+                        unsigned char *lengths, uint64_t code, unsigned depth) {
+    const huffman_tree::node & n = tree.nodes[k];
+    if (n.left == TREE_NONE) {
+        codes[n.character] = code;
+        lengths[n.character] = depth;
+        return true;
+    }
+    if (depth == 64) return false;
+
+    // traverse through the tree and record the path as the program go.
+    // add 0 to the code if the character located on the left of the tree
+    // add 1 to the code if the character located on the right of the tree
+    return make_subtree_codes(tree, n.left, codes, lengths, code << 1, depth + 1) &&
+           make_subtree_codes(tree, n.right, codes, lengths, (code << 1) | 1, depth + 1);
+}
+
+}
+
+bool read_tree(const unsigned char *& in, const unsigned char *end, huffman_tree & tree) {
+    // preorder, like write_tree; children come before their parent in the array
+
+    tree.clear();
+    tree.root = read_subtree(in, end, 0, tree);
+    return tree.root != TREE_NONE;
+}
+
+size_t write_tree(const huffman_tree & tree, unsigned char *out) {
+    // example output: ILaILbLc
+
+    return write_subtree(tree, tree.root, out);
+}
+
+bool make_codes(const huffman_tree & tree, uint64_t *codes, unsigned char *lengths) {
+    // builds integer codes from a Huffman tree
+
+    return make_subtree_codes(tree, tree.root, codes, lengths, 0, 0);
+}
+
+bool make_code_lengths(const size_t *counts, unsigned char *lengths, unsigned max_bits,
+                       tree_builder builder) {
+    // read the code lengths off the Huffman tree, falling back to package-merge
+    // when the tree is deeper than allowed
+
+    if (std::all_of(counts, counts + 256, [](size_t c) { return c == 0; })) return false;
+    if (max_bits == 0 || max_bits > CANONICAL_MAX_BITS) max_bits = CANONICAL_MAX_BITS;
+
+    bool fits = true;
+    if (builder == TREE_BUILDER_SORTED) {
+        sorted_code_lengths(counts, 256, lengths);
+    }
+    else {
+        std::fill(lengths, lengths + 256, 0);
+        uint64_t codes[256];
+        huffman_tree tree;
+        make_tree(counts, tree, builder);
+        fits = make_codes(tree, codes, lengths);
+        if (tree.is_leaf(tree.root)) lengths[tree.nodes[tree.root].character] = 1;
+    }
+
+    if (fits && *std::max_element(lengths, lengths + 256) <= max_bits) return true;
+    return package_merge(counts, 256, max_bits, lengths);
+}
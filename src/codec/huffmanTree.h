@@ -0,0 +1,80 @@
+/***************************************************************************************************
+    File: huffmanTree.h
+
+    Description:
+        The Huffman tree: a flat array of nodes, the tree-building algorithm over a min-heap of
+        subtrees, and the codes read off the tree (0 is left, 1 is right). Shared by every
+        format; the formats that only store code lengths use make_code_lengths.
+
+***************************************************************************************************/
+#ifndef HUFFMAN_TREE_H
+#define HUFFMAN_TREE_H
+
+#include <cstdint>
+#include <cstddef>
+
+// a tree of 256 leaves has 255 internal nodes
+const size_t TREE_MAX_NODES = 511;
+
+// the child index of a leaf, and what adding to a full tree returns
+const uint16_t TREE_NONE = 0xffff;
+
+// A Huffman tree kept in one fixed array: nodes refer to their children by index, so
+// building, reading and walking a tree never allocates, and the tree is freed with the
+// object that holds it. A context that handles many trees keeps one and clears it.
+struct huffman_tree {
+    struct node {
+        uint16_t left;              // TREE_NONE for a leaf
+        uint16_t right;
+        uint16_t character;         // the character of a leaf
+    };
+
+    node nodes[TREE_MAX_NODES];
+    uint16_t size = 0;              // nodes in use
+    uint16_t root = 0;
+
+    void clear() { size = root = 0; }
+    bool is_leaf(uint16_t k) const { return nodes[k].left == TREE_NONE; }
+
+    // add a leaf, or an internal node over two nodes, and return its index
+    uint16_t add_leaf(unsigned char character);
+    uint16_t add_internal(uint16_t left, uint16_t right);
+};
+
+// how make_tree and make_code_lengths build the code: all give a code of the same size,
+// but the sorted counts may give different lengths to characters of equal count
+enum tree_builder {
+    TREE_BUILDER_HEAP,          // build the tree with make_tree and read the lengths off it
+    TREE_BUILDER_SORTED,        // sort the counts and use sorted_code_lengths, in linear time
+    TREE_BUILDER_LIST           // same as TREE_BUILDER_HEAP, queueing in a priority_queue
+};
+
+// Assemble a queue of Huffman trees into one Huffman tree of the characters counted
+// in counts, which must not all be zero. The queue is a min_heap, or the linked list
+// of priority_queue with TREE_BUILDER_LIST; both build the same tree.
+void make_tree(const size_t *counts, huffman_tree & tree,
+               tree_builder builder = TREE_BUILDER_HEAP);
+
+// read a tree written in the I/L form of the original format (an internal node is 'I'
+// followed by its two subtrees, a leaf is 'L' followed by its character) from the bytes
+// [in, end), moving in past it. Returns false if the bytes do not hold a whole tree.
+bool read_tree(const unsigned char *& in, const unsigned char *end, huffman_tree & tree);
+
+// largest I/L form of a tree: 256 leaves of two bytes and 255 internal nodes of one
+const size_t TREE_FORM_BOUND = 256 * 2 + 255;
+
+// write the I/L form of a tree to out (at most TREE_FORM_BOUND bytes) and return its size
+size_t write_tree(const huffman_tree & tree, unsigned char *out);
+
+// builds integer codes from a Huffman tree: the code of a character is the
+// low lengths[character] bits of codes[character], read from the most
+// significant end. Returns false if a leaf is deeper than 64 bits.
+bool make_codes(const huffman_tree & tree, uint64_t *codes, unsigned char *lengths);
+
+// code lengths of the Huffman tree of counts for canonical codes: a lone character
+// gets one bit, and codes are limited to max_bits (or to the longest canonical code
+// when max_bits is 0). Returns false if there are no characters or they do not fit.
+bool make_code_lengths(const size_t *counts, unsigned char *lengths, unsigned max_bits,
+                       tree_builder builder = TREE_BUILDER_SORTED);
+
+#endif
@@ -0,0 +1,83 @@
+/***************************************************************************************************
+    File: packageMerge.cc
+
+    Description:
+        Package-merge works on max_bits lists, one per code length, deepest first. The deepest
+        list holds the symbols sorted by count. Each shallower list merges the same symbols with
+        "packages" made by pairing up neighbours of the list below. The cheapest 2n - 2 items of
+        the last list make up the optimal code: each time a symbol is part of a chosen item,
+        directly or inside a package, its code gets one bit longer.
+
+***************************************************************************************************/
+#include <algorithm>
+#include <vector>
+#include "packageMerge.h"
+
+namespace {
+
+struct pm_item {
+    size_t weight;      // count of a symbol or sum of a package
+    int symbol;         // symbol, or -1 for a package of two items of the list below
+};
+
+}
+
+bool package_merge(const size_t *counts, size_t num_symbols, unsigned max_bits,
+                   unsigned char *lengths) {
+    // sort the used symbols by count, then build the lists from the deepest up
+
+    std::vector<pm_item> leaves;
+    for (size_t s = 0; s < num_symbols; s++) {
+        lengths[s] = 0;
+        if (counts[s] != 0) leaves.push_back({counts[s], (int)s});
+    }
+    size_t n = leaves.size();
+    if (n == 0) return true;
+    if (max_bits == 0 || (max_bits < 8 * sizeof(size_t) && n > ((size_t)1 << max_bits))) {
+        return false;
+    }
+    if (n == 1) {
+        lengths[leaves[0].symbol] = 1;
+        return true;
+    }
+    std::stable_sort(leaves.begin(), leaves.end(), [](const pm_item & a, const pm_item & b) {
+        return a.weight < b.weight;
+    });
+
+    // no list needs more items than 2n - 2, and a code never needs more than n - 1 bits
+    max_bits = std::min<size_t>(max_bits, n - 1);
+    std::vector<std::vector<pm_item>> lists(max_bits);
+    lists[0] = leaves;
+    for (unsigned level = 1; level < max_bits; level++) {
+        const std::vector<pm_item> & below = lists[level - 1];
+        std::vector<pm_item> & list = lists[level];
+
+        // merge the leaves with the packages of the list below, leaves first on ties
+        size_t leaf = 0, pair = 0;
+        while (list.size() < 2 * n - 2 && (leaf < n || pair + 1 < below.size())) {
+            bool take_package = pair + 1 < below.size() &&
+                (leaf == n || below[pair].weight + below[pair + 1].weight < leaves[leaf].weight);
+            if (take_package) {
+                list.push_back({below[pair].weight + below[pair + 1].weight, -1});
+                pair += 2;
+            }
+            else {
+                list.push_back(leaves[leaf++]);
+            }
+        }
+    }
+
+    // the chosen items are a prefix of every list: walk down from the last list,
+    // counting the symbols and following the packages into the list below
+    size_t chosen = 2 * n - 2;
+    for (unsigned level = max_bits; level-- > 0; ) {
+        size_t packages = 0;
+        for (size_t i = 0; i < chosen; i++) {
+            const pm_item & item = lists[level][i];
+            if (item.symbol < 0) packages++;
+            else lengths[item.symbol]++;
+        }
+        chosen = 2 * packages;
+    }
+    return true;
+}
@@ -0,0 +1,21 @@
+/***************************************************************************************************
+    File: packageMerge.h
+
+    Description:
+        Length-limited Huffman code lengths using the package-merge (coin collector) algorithm.
+        Among all prefix codes whose codes are at most max_bits long, it finds code lengths
+        with the smallest encoded size, so a decoder can rely on a fixed table size.
+
+***************************************************************************************************/
+#ifndef PACKAGE_MERGE_H
+#define PACKAGE_MERGE_H
+
+#include <cstddef>
+
+// fill lengths with optimal code lengths of at most max_bits bits for the symbols with
+// a non-zero count (the others get 0). A lone symbol gets a code of one bit. Returns
+// false if the symbols do not fit in max_bits bits.
+bool package_merge(const size_t *counts, size_t num_symbols, unsigned max_bits,
+                   unsigned char *lengths);
+
+#endif
@@ -0,0 +1,66 @@
+/***************************************************************************************************
+    File: sharedTable.cc
+
+    Description:
+        Training, saving and loading shared code tables.
+
+***************************************************************************************************/
+#include <algorithm>
+#include "sharedTable.h"
+#include "format.h"
+#include "huffmanTree.h"
+
+namespace {
+
+uint32_t table_id(const unsigned char *lengths) {
+    // 32-bit FNV-1a of the code lengths
+
+    uint32_t hash = 2166136261u;
+    for (int k = 0; k < 256; k++) hash = (hash ^ lengths[k]) * 16777619u;
+    return hash;
+}
+
+bool finish_code(shared_code & code) {
+    // the canonical codes and the ID of a table whose lengths are set
+
+    if (!make_canonical_codes(code.lengths, code.codes, 256)) return false;
+    code.max_length = *std::max_element(code.lengths, code.lengths + 256);
+    code.id = table_id(code.lengths);
+    return true;
+}
+
+}
+
+bool train_shared_code(const size_t *counts, unsigned max_bits, shared_code & code) {
+    // one more of every byte value than the samples hold, so that none is left
+    // without a code and the common ones keep their share
+
+    size_t floored[256];
+    for (int k = 0; k < 256; k++) floored[k] = counts[k] + 1;
+    if (max_bits == 0) max_bits = DEFAULT_TABLE_MAX_BITS;
+    return max_bits >= 8 && make_code_lengths(floored, code.lengths, max_bits) && finish_code(code);
+}
+
+size_t write_table_file(const shared_code & code, unsigned char *out) {
+    std::copy(TABLE_FILE_MAGIC, TABLE_FILE_MAGIC + 4, out);
+    store_le(out + 4, code.id, 4);
+    size_t table_size = write_code_lengths(code.lengths, 256, out + TABLE_FILE_HEADER_SIZE);
+    store_le(out + 8, table_size, 2);
+    return TABLE_FILE_HEADER_SIZE + table_size;
+}
+
+size_t read_table_file(const unsigned char *in, size_t size, shared_code & code) {
+    // the lengths must give every byte value a code, and the ID must match them
+
+    if (size < TABLE_FILE_HEADER_SIZE || !std::equal(TABLE_FILE_MAGIC, TABLE_FILE_MAGIC + 4, in)) {
+        return 0;
+    }
+    size_t table_size = load_le(in + 8, 2);
+    if (table_size > size - TABLE_FILE_HEADER_SIZE ||
+        !read_code_lengths(in + TABLE_FILE_HEADER_SIZE, table_size, code.lengths, 256) ||
+        std::count(code.lengths, code.lengths + 256, 0) != 0 ||
+        !finish_code(code) || code.id != load_le(in + 4, 4)) {
+        return 0;
+    }
+    return TABLE_FILE_HEADER_SIZE + table_size;
+}
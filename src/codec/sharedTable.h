@@ -0,0 +1,50 @@
+/***************************************************************************************************
+    File: sharedTable.h
+
+    Description:
+        Code tables shared by many small files. A table is trained once on the histogram of
+        sample data and saved to a table file; files compressed with it (format version 3,
+        see format.h) carry only the ID of the table instead of a code of their own, and
+        are coded in a single pass since their bytes need not be counted first. Every byte
+        value gets a code, whether the samples hold it or not.
+
+        Table file:
+            "HZT" 1 | table ID (4 bytes) | code length table size (2 bytes) |
+            code length table (see canonical.h)
+        The ID is a hash of the code lengths, so two tables with the same codes have the
+        same ID, and a file is never decoded with a table that has other codes.
+
+***************************************************************************************************/
+#ifndef SHARED_TABLE_H
+#define SHARED_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include "canonical.h"
+
+const unsigned char TABLE_FILE_MAGIC[4] = {'H', 'Z', 'T', 1};
+const size_t TABLE_FILE_HEADER_SIZE = 10;
+const size_t TABLE_FILE_BOUND = TABLE_FILE_HEADER_SIZE + code_lengths_bound(256);
+const unsigned DEFAULT_TABLE_MAX_BITS = 15;     // keeps rare bytes from costing many bytes
+
+// the code of a table
+struct shared_code {
+    uint32_t id;
+    unsigned char lengths[256];
+    uint64_t codes[256];
+    unsigned max_length;            // longest code
+};
+
+// build the code of a table from the counts of the sample bytes, with codes of at most
+// max_bits bits (DEFAULT_TABLE_MAX_BITS when 0). Returns false if max_bits is too short
+// for 256 codes.
+bool train_shared_code(const size_t *counts, unsigned max_bits, shared_code & code);
+
+// write the table file of code to out (at most TABLE_FILE_BOUND bytes) and return its size
+size_t write_table_file(const shared_code & code, unsigned char *out);
+
+// read a table file from the size bytes at in. Returns how many bytes it takes, or 0 if
+// they do not start with a whole table file.
+size_t read_table_file(const unsigned char *in, size_t size, shared_code & code);
+
+#endif
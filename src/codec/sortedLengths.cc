@@ -0,0 +1,126 @@
+/***************************************************************************************************
+    File: sortedLengths.cc
+
+    Description:
+        The radix sort takes one pass per byte of the largest count, so the counts of a 64K
+        block need three. The lengths come from the three phases of Moffat and Katajainen,
+        "In-place calculation of minimum-redundancy codes" (1995): the sorted weights are
+        merged into internal nodes that record their parents, the parents become depths, and
+        the depths of the internal nodes are handed out as the lengths of the leaves.
+
+***************************************************************************************************/
+#include <algorithm>
+#include <vector>
+#include "sortedLengths.h"
+
+namespace {
+
+size_t sort_into(const size_t *counts, size_t num_symbols, uint16_t *order, uint16_t *buffer) {
+    // LSD radix sort of the symbols by count, a byte at a time; each pass is stable,
+    // so equal counts stay in the order of their symbols. buffer holds as many
+    // symbols as order.
+
+    size_t n = 0;
+    size_t largest = 0;
+    for (size_t s = 0; s < num_symbols; s++) {
+        if (counts[s] == 0) continue;
+        order[n++] = (uint16_t)s;
+        largest = std::max(largest, counts[s]);
+    }
+
+    uint16_t *from = order, *to = buffer;
+    for (unsigned shift = 0; shift < 8 * sizeof(size_t) && (largest >> shift) != 0; shift += 8) {
+        size_t start[257] = {};
+        for (size_t i = 0; i < n; i++) start[((counts[from[i]] >> shift) & 0xff) + 1]++;
+        for (unsigned d = 0; d < 256; d++) start[d + 1] += start[d];
+        for (size_t i = 0; i < n; i++) to[start[(counts[from[i]] >> shift) & 0xff]++] = from[i];
+        std::swap(from, to);
+    }
+    if (from != order) std::copy(from, from + n, order);
+    return n;
+}
+
+bool lengths_into(const size_t *counts, size_t num_symbols, unsigned char *lengths,
+                  uint16_t *order, uint16_t *buffer, size_t *a) {
+    // the symbols in increasing order of count, then Moffat-Katajainen over their
+    // counts in a, which holds as many counts as there are symbols
+
+    size_t n = sort_into(counts, num_symbols, order, buffer);
+    std::fill(lengths, lengths + num_symbols, 0);
+    if (n == 0) return false;
+    if (n == 1) {
+        lengths[order[0]] = 1;
+        return true;
+    }
+
+    for (size_t i = 0; i < n; i++) a[i] = counts[order[i]];
+
+    // phase 1: a[next] becomes the weight of the next internal node, made of the two
+    // lightest leaves or nodes; a node that is used up records its parent instead
+    size_t leaf = 2, root = 0;
+    a[0] += a[1];
+    for (size_t next = 1; next < n - 1; next++) {
+        if (leaf >= n || a[root] < a[leaf]) {
+            a[next] = a[root];
+            a[root++] = next;
+        }
+        else {
+            a[next] = a[leaf++];
+        }
+        if (leaf >= n || (root < next && a[root] < a[leaf])) {
+            a[next] += a[root];
+            a[root++] = next;
+        }
+        else {
+            a[next] += a[leaf++];
+        }
+    }
+
+    // phase 2: the depth of each internal node, from the root at n - 2 down
+    a[n - 2] = 0;
+    for (size_t next = n - 2; next-- > 0;) a[next] = a[a[next]] + 1;
+
+    // phase 3: every level has twice as many places as the internal nodes above it;
+    // those not taken by internal nodes go to leaves, the heaviest first
+    size_t available = 1, used = 0, depth = 0;
+    size_t next = n;
+    size_t node = n - 1;                    // internal nodes n - 2 down to 0, plus one
+    while (available > 0) {
+        while (node > 0 && a[node - 1] == depth) {
+            used++;
+            node--;
+        }
+        while (available > used) {
+            a[--next] = depth;
+            available--;
+        }
+        available = 2 * used;
+        depth++;
+        used = 0;
+    }
+
+    for (size_t i = 0; i < n; i++) lengths[order[i]] = (unsigned char)a[i];
+    return true;
+}
+
+}
+
+size_t sort_symbols(const size_t *counts, size_t num_symbols, uint16_t *order) {
+    if (num_symbols <= SORTED_STACK_SYMBOLS) {
+        uint16_t buffer[SORTED_STACK_SYMBOLS];
+        return sort_into(counts, num_symbols, order, buffer);
+    }
+    std::vector<uint16_t> buffer(num_symbols);
+    return sort_into(counts, num_symbols, order, buffer.data());
+}
+
+bool sorted_code_lengths(const size_t *counts, size_t num_symbols, unsigned char *lengths) {
+    if (num_symbols <= SORTED_STACK_SYMBOLS) {
+        uint16_t order[SORTED_STACK_SYMBOLS], buffer[SORTED_STACK_SYMBOLS];
+        size_t a[SORTED_STACK_SYMBOLS];
+        return lengths_into(counts, num_symbols, lengths, order, buffer, a);
+    }
+    std::vector<uint16_t> order(num_symbols), buffer(num_symbols);
+    std::vector<size_t> a(num_symbols);
+    return lengths_into(counts, num_symbols, lengths, order.data(), buffer.data(), a.data());
+}
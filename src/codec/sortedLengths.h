@@ -0,0 +1,32 @@
+/***************************************************************************************************
+    File: sortedLengths.h
+
+    Description:
+        Huffman code lengths in linear time without building a tree: the used symbols are
+        radix sorted by count once, and the in-place method of Moffat and Katajainen turns
+        the sorted counts into code lengths in the same array. Nothing is allocated for up
+        to 256 symbols, so a block coder can afford a new code for every block however
+        small; larger alphabets (up to 64K symbols) get their scratch space from the heap.
+
+***************************************************************************************************/
+#ifndef SORTED_LENGTHS_H
+#define SORTED_LENGTHS_H
+
+#include <cstddef>
+#include <cstdint>
+
+// the most symbols sort_symbols and sorted_code_lengths take, and the most they take
+// without allocating
+const size_t SORTED_MAX_SYMBOLS = 1 << 16;
+const size_t SORTED_STACK_SYMBOLS = 256;
+
+// write the symbols with a non-zero count to order, by increasing count and by symbol
+// among equal counts, and return how many there are
+size_t sort_symbols(const size_t *counts, size_t num_symbols, uint16_t *order);
+
+// fill lengths with the code lengths of a Huffman code for the symbols with a non-zero
+// count (the others get 0); a lone symbol gets a code of one bit. Codes may be longer
+// than 64 bits. Returns false if there are no symbols.
+bool sorted_code_lengths(const size_t *counts, size_t num_symbols, unsigned char *lengths);
+
+#endif
@@ -0,0 +1,180 @@
+/***************************************************************************************************
+    File: symbolCode.cc
+
+    Description:
+        The symbol coder, instantiated for 16-bit and 32-bit symbols.
+
+***************************************************************************************************/
+#include <algorithm>
+#include "symbolCode.h"
+#include "canonical.h"
+#include "format.h"
+#include "packageMerge.h"
+#include "sortedLengths.h"
+
+template <typename Symbol>
+bool count_symbols(const Symbol *data, size_t n, symbol_counts & counts) {
+    // A short array is sorted and its runs counted, which costs as much as its symbols.
+    // A longer one goes through one table of counters over the alphabet, which is set to
+    // zero once, not per array: only the counters of the symbols that occur are read
+    // back and cleared. Below the size of the alphabet, each symbol is noted the first
+    // time it is seen; from there on, plain counting is faster and a scan of the table
+    // costs less than the count. The symbols are spread over a larger table than bytes,
+    // so the same counter rarely waits for the one before.
+
+    counts.symbols.clear();
+    counts.counts.clear();
+    if (n < SORTED_COUNT_LIMIT) {
+        std::vector<uint32_t> & sorted = counts.sorted;
+        sorted.assign(data, data + n);
+        std::sort(sorted.begin(), sorted.end());
+        if (n > 0 && sorted.back() >= MAX_ALPHABET_SIZE) return false;
+        for (size_t i = 0, j; i < n; i = j) {
+            for (j = i + 1; j < n && sorted[j] == sorted[i]; j++) {}
+            counts.symbols.push_back(sorted[i]);
+            counts.counts.push_back(j - i);
+        }
+        return true;
+    }
+
+    if (counts.table.empty()) counts.table.assign(MAX_ALPHABET_SIZE, 0);
+    size_t *table = counts.table.data();
+    size_t i = 0;
+    if (n < MAX_ALPHABET_SIZE) {
+        for (; i < n && data[i] < MAX_ALPHABET_SIZE; i++) {
+            if (table[data[i]]++ == 0) counts.symbols.push_back(data[i]);
+        }
+        std::sort(counts.symbols.begin(), counts.symbols.end());
+    }
+    else {
+        for (; i < n && data[i] < MAX_ALPHABET_SIZE; i++) table[data[i]]++;
+        for (uint32_t symbol = 0; symbol < MAX_ALPHABET_SIZE; symbol++) {
+            if (table[symbol]) counts.symbols.push_back(symbol);
+        }
+    }
+    for (uint32_t symbol : counts.symbols) {
+        counts.counts.push_back(table[symbol]);
+        table[symbol] = 0;
+    }
+    return i == n;
+}
+
+template <typename Symbol>
+bool build_symbol_code(const symbol_counts & counts, unsigned max_bits,
+                       symbol_code<Symbol> & code) {
+    // only the symbols that occur take part, so the lengths of a sparse alphabet are
+    // built over a short list
+
+    code.symbols.assign(counts.symbols.begin(), counts.symbols.end());
+    size_t used = code.symbols.size();
+    code.lengths.resize(used);
+    code.codes.resize(used);
+    if (used == 0) return false;
+
+    if (max_bits == 0 || max_bits > CANONICAL_MAX_BITS) max_bits = CANONICAL_MAX_BITS;
+    sorted_code_lengths(counts.counts.data(), used, code.lengths.data());
+    if (*std::max_element(code.lengths.begin(), code.lengths.end()) > max_bits &&
+        !package_merge(counts.counts.data(), used, max_bits, code.lengths.data())) {
+        return false;
+    }
+
+    // the used symbols are in increasing order, so their canonical codes are those
+    // of the whole alphabet
+    code.max_length = *std::max_element(code.lengths.begin(), code.lengths.end());
+    return make_canonical_codes(code.lengths.data(), code.codes.data(), used);
+}
+
+template <typename Symbol>
+size_t write_symbol_code(const symbol_code<Symbol> & code, unsigned char *out) {
+    size_t size = store_varint(out, code.symbols.size());
+    size_t next = 0;        // the symbol a gap of 0 stands for
+    for (size_t i = 0; i < code.symbols.size(); i++) {
+        size += store_varint(out + size, code.symbols[i] - next);
+        out[size++] = code.lengths[i];
+        next = (size_t)code.symbols[i] + 1;
+    }
+    return size;
+}
+
+template <typename Symbol>
+size_t read_symbol_code(const unsigned char *in, size_t size, symbol_code<Symbol> & code) {
+    // the symbols must stay inside the alphabet and the lengths must make a code
+
+    const unsigned char *end = in + size;
+    uint64_t used;
+    size_t offset = load_varint(in, end, used);
+    if (offset == 0 || used == 0 || used > MAX_ALPHABET_SIZE) return 0;
+    code.symbols.resize(used);
+    code.lengths.resize(used);
+    code.codes.resize(used);
+    uint64_t next = 0;
+    for (size_t i = 0; i < used; i++) {
+        uint64_t gap;
+        size_t n = load_varint(in + offset, end, gap);
+        if (n == 0 || gap >= MAX_ALPHABET_SIZE - next || offset + n >= size) return 0;
+        offset += n;
+        code.symbols[i] = (Symbol)(next + gap);
+        code.lengths[i] = in[offset++];
+        if (code.lengths[i] == 0) return 0;
+        next += gap + 1;
+    }
+    code.max_length = *std::max_element(code.lengths.begin(), code.lengths.end());
+    if (!make_canonical_codes(code.lengths.data(), code.codes.data(), used)) return 0;
+    return offset;
+}
+
+template <typename Symbol>
+void symbol_encoder<Symbol>::build(const symbol_code<Symbol> & code) {
+    size_t size = code.symbols.empty() ? 0 : (size_t)code.symbols.back() + 1;
+    _codes.assign(size, 0);
+    _lengths.assign(size, 0);
+    for (size_t i = 0; i < code.symbols.size(); i++) {
+        _codes[code.symbols[i]] = code.codes[i];
+        _lengths[code.symbols[i]] = code.lengths[i];
+    }
+}
+
+template <typename Symbol>
+bool symbol_decoder<Symbol>::build(const symbol_code<Symbol> & code) {
+    // the table decodes the index of a used symbol
+
+    _symbols = code.symbols;
+    _max_length = code.max_length;
+    return _table.build(code.codes.data(), code.lengths.data(), code.symbols.size());
+}
+
+template <typename Symbol>
+bool symbol_decoder<Symbol>::decode(bit_reader & in, Symbol *out, size_t n) const {
+    // A refill leaves at least 56 bits, enough for two codes of up to 28 bits
+
+    const Symbol *symbols = _symbols.data();
+    size_t i = 0;
+    if (_max_length <= 28) {
+        for (; i + 2 <= n; i += 2) {
+            in.refill();
+            long first = _table.decode(in);
+            long second = first < 0 ? -1 : _table.decode(in);
+            if (second < 0) return false;
+            out[i] = symbols[first];
+            out[i + 1] = symbols[second];
+        }
+    }
+    for (; i < n; i++) {
+        in.refill();
+        long index = _table.decode(in);
+        if (index < 0) return false;
+        out[i] = symbols[index];
+    }
+    return true;
+}
+
+#define INSTANTIATE_SYMBOL_CODE(Symbol)                                                         \
+    template bool count_symbols(const Symbol *, size_t, symbol_counts &);                       \
+    template bool build_symbol_code(const symbol_counts &, unsigned, symbol_code<Symbol> &);   \
+    template size_t write_symbol_code(const symbol_code<Symbol> &, unsigned char *);           \
+    template size_t read_symbol_code(const unsigned char *, size_t, symbol_code<Symbol> &);     \
+    template class symbol_encoder<Symbol>;                                                      \
+    template class symbol_decoder<Symbol>;
+
+INSTANTIATE_SYMBOL_CODE(uint16_t)
+INSTANTIATE_SYMBOL_CODE(uint32_t)
@@ -0,0 +1,119 @@
+/***************************************************************************************************
+    File: symbolCode.h
+
+    Description:
+        Huffman codes over symbols wider than a byte: 16-bit samples, or integer token IDs,
+        from alphabets of up to MAX_ALPHABET_SIZE symbols. Coding such a stream as its bytes
+        splits every symbol over two codes of unrelated byte statistics, which costs both
+        time and size; these functions count, build codes for and code the symbols
+        themselves.
+
+        Everything is a template on the symbol type, instantiated for uint16_t and uint32_t.
+        Bytes keep their own coder (count_bytes, make_code_lengths and the multi-symbol
+        decode_table), which handles a full alphabet of 256 without listing it. Symbols of
+        either width must be below MAX_ALPHABET_SIZE: a 32-bit symbol is an index into the
+        same tables as a 16-bit one.
+
+        Large alphabets are handled sparsely: the counts list only the symbols that occur,
+        and so does a code, in increasing order, so its lengths are built over those symbols
+        alone, and its table stores the gaps between them. A stream that uses 300 of 65536
+        token IDs pays for 300 counts and code lengths, not 65536.
+
+        Symbol code table:
+            used symbols (varint) | per used symbol: gap (varint) | code length (1 byte)
+        The gap of a symbol is its distance from the previous used symbol minus one, and
+        that of the first symbol is the symbol itself.
+
+***************************************************************************************************/
+#ifndef SYMBOL_CODE_H
+#define SYMBOL_CODE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "bitReader.h"
+#include "bitWriter.h"
+#include "decodeTable.h"
+
+// symbols are 0 to MAX_ALPHABET_SIZE - 1
+const size_t MAX_ALPHABET_SIZE = 1 << 16;
+
+// largest symbol code table of a code of used symbols
+constexpr size_t symbol_code_bound(size_t used) { return 3 + used * 4; }
+
+template <typename Symbol>
+struct symbol_code {
+    std::vector<Symbol> symbols;            // the symbols that occur, in increasing order
+    std::vector<unsigned char> lengths;     // the code length of each of them
+    std::vector<uint64_t> codes;            // and its canonical code
+    unsigned max_length = 0;                // longest code
+};
+
+// arrays shorter than this are counted by sorting a copy, longer ones in a table
+const size_t SORTED_COUNT_LIMIT = 1024;
+
+// the symbols of an array that occur, in increasing order, and how often each does,
+// with the scratch memory that counts them
+struct symbol_counts {
+    std::vector<uint32_t> symbols;
+    std::vector<size_t> counts;
+    std::vector<size_t> table;          // a counter per symbol of the alphabet, zero
+                                        // between arrays; empty until a long array
+    std::vector<uint32_t> sorted;       // the sorted copy of a short array
+};
+
+// count the symbols of data[0..n) into counts, in place of what it held. Returns false if
+// a symbol is outside the alphabet.
+template <typename Symbol>
+bool count_symbols(const Symbol *data, size_t n, symbol_counts & counts);
+
+// build the canonical code of the counted symbols, limited to max_bits bits when it is
+// not 0. Returns false if no symbol was counted or they do not fit in max_bits bits.
+template <typename Symbol>
+bool build_symbol_code(const symbol_counts & counts, unsigned max_bits,
+                       symbol_code<Symbol> & code);
+
+// write the symbol code table of code (at most symbol_code_bound(code.symbols.size())
+// bytes) to out and return its size
+template <typename Symbol>
+size_t write_symbol_code(const symbol_code<Symbol> & code, unsigned char *out);
+
+// read a symbol code table from the size bytes at in and assign its codes. Returns its
+// size, or 0 if the bytes do not start with a valid table.
+template <typename Symbol>
+size_t read_symbol_code(const unsigned char *in, size_t size, symbol_code<Symbol> & code);
+
+template <typename Symbol>
+class symbol_encoder {
+    private:
+        std::vector<uint64_t> _codes;           // by symbol, up to the largest used one
+        std::vector<unsigned char> _lengths;
+
+    public:
+        void build(const symbol_code<Symbol> & code);
+
+        // append the codes of n symbols, all of which must have a code
+        void encode(const Symbol *in, size_t n, bit_writer & out) const {
+            for (size_t i = 0; i < n; i++) out.put(_codes[in[i]], _lengths[in[i]]);
+        }
+};
+
+template <typename Symbol>
+class symbol_decoder {
+    private:
+        decode_table _table;                    // decodes the index of a used symbol
+        std::vector<Symbol> _symbols;           // the used symbols, by index
+        unsigned _max_length = 0;
+
+    public:
+        // Returns false if the code cannot be decoded
+        bool build(const symbol_code<Symbol> & code);
+
+        // decode n symbols into out. Returns false on a corrupt stream.
+        bool decode(bit_reader & in, Symbol *out, size_t n) const;
+
+        // length of the longest code, which bounds the bits a symbol takes
+        unsigned max_length() const { return _max_length; }
+};
+
+#endif
@@ -0,0 +1,79 @@
+/***************************************************************************************************
+    File: threadPool.cc
+
+    Description:
+        Worker threads of the thread pool.
+
+***************************************************************************************************/
+#include <algorithm>
+#include "threadPool.h"
+
+thread_pool::thread_pool(unsigned threads)
+    : _task(nullptr), _next(0), _count(0), _busy(0), _generation(0), _stop(false) {
+    // start the workers; the calling thread is the last member of the pool
+
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned i = 1; i < threads; i++) {
+        _workers.emplace_back(&thread_pool::_worker_main, this);
+    }
+}
+
+thread_pool::~thread_pool() {
+    // wake the workers up to stop and wait for them
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _wake.notify_all();
+    for (std::thread & worker : _workers) worker.join();
+}
+
+void thread_pool::_work() {
+    // take indices of the current loop until there are none left
+
+    for (size_t i = _next++; i < _count; i = _next++) {
+        (*_task)(i);
+    }
+}
+
+void thread_pool::_worker_main() {
+    // wait for a loop, help finish it, and report back
+
+    uint64_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _wake.wait(lock, [&] { return _stop || _generation != seen; });
+            if (_stop) return;
+            seen = _generation;
+        }
+        _work();
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (--_busy == 0) _done.notify_one();
+        }
+    }
+}
+
+void thread_pool::run(size_t count, const std::function<void(size_t)> & task) {
+    // publish the loop, take part in it, then wait for the workers to leave it
+
+    if (_workers.empty() || count <= 1) {
+        for (size_t i = 0; i < count; i++) task(i);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _task = &task;
+        _count = count;
+        _next = 0;
+        _busy = _workers.size();
+        _generation++;
+    }
+    _wake.notify_all();
+    _work();
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _done.wait(lock, [&] { return _busy == 0; });
+}
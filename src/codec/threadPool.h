@@ -0,0 +1,57 @@
+/***************************************************************************************************
+    File: threadPool.h
+
+    Description:
+        A fixed set of worker threads that run parallel loops. run(count, task) calls task(i)
+        for every i below count, spread over the workers and the calling thread, and returns
+        once all calls are done. The workers sleep between loops, so a pool is created once
+        and reused for every batch of blocks.
+
+***************************************************************************************************/
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class thread_pool {
+    private:
+        std::vector<std::thread> _workers;
+        std::mutex _mutex;
+        std::condition_variable _wake;              // a new loop is ready, or stop
+        std::condition_variable _done;              // the last worker left the loop
+        const std::function<void(size_t)> *_task;   // body of the current loop
+        std::atomic<size_t> _next;                  // next index to hand out
+        size_t _count;                              // number of indices of the current loop
+        size_t _busy;                               // workers still in the current loop
+        uint64_t _generation;                       // number of loops started so far
+        bool _stop;
+
+        // take indices of the current loop until there are none left
+        void _work();
+
+        // body of a worker thread
+        void _worker_main();
+
+    public:
+        // start threads - 1 workers (0 picks the number of cores)
+        thread_pool(unsigned threads = 0);
+        ~thread_pool();
+
+        thread_pool(const thread_pool &) = delete;
+        thread_pool & operator=(const thread_pool &) = delete;
+
+        // number of threads taking part in a loop, including the caller
+        unsigned size() const { return (unsigned)_workers.size() + 1; }
+
+        // call task(i) for i in [0, count) in parallel and wait for all of them
+        void run(size_t count, const std::function<void(size_t)> & task);
+};
+
+#endif
@@ -14,292 +14,995 @@
 #include <iostream>
 #include <fstream>
 #include <cstdlib>
-#include "queue/minHeap.h"
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "codec/decodeTable.h"
+#include "codec/canonical.h"
+#include "codec/contextModel.h"
+#include "codec/fileHeader.h"
+#include "codec/huffmanTree.h"
+#include "codec/block.h"
+#include "codec/blockIndex.h"
+#include "codec/threadPool.h"
+#include "codec/histogram.h"
+#include "io/rangeBuffer.h"
+#include "io/mappedFile.h"
+#include "io/pipeline.h"
+#include "io/runStats.h"
+#include "lib/huffman.h"
+#include "codec/format.h"
 
-// Define a node of a Huffman tree
-struct hnode {
-    int character;
-    size_t count;
-    hnode *left;
-    hnode *right;
-    hnode( int character, size_t count, hnode *left = NULL, hnode *right = NULL)
-        : character(character), count(count), left(left), right(right) {}
+run_stats *stats = nullptr;  // what --stats reports, null when it was not asked for
+huffman::phase_times library_times;     // the phases libhuffman timed, for the report
+
+static_assert((int)PHASE_COUNT == (int)huffman::PHASE_COUNT, "the phases of the report differ");
+
+huffman::phase_times *timing() {
+    // where libhuffman is to time its phases: nowhere without --stats, so it does not
+    // read the clock
+
+    return stats ? &library_times : nullptr;
+}
+
+// how compress was asked to encode the file
+struct compress_options {
+    format_version format = FORMAT_LEGACY;
+    unsigned max_bits = 0;                  // code length limit, 0 for none
+    size_t block_size = DEFAULT_BLOCK_SIZE; // block size of the block format
+    unsigned threads = 0;                   // threads of the block format, 0 for all cores
+    bool index = true;                      // end the block format with a block index
+    size_t sync_interval = 0;               // bytes between sync points in the index, 0 for none
+    unsigned streams = DEFAULT_STREAMS;     // streams per block of the block format
+    unsigned min_gain = DEFAULT_MIN_GAIN;   // percent a block must shrink by, or it is stored
+    const char *table_file = nullptr;       // shared table of the table format
+    size_t sample_size = 0;                 // bytes to build the code from, 0 for all of them
+    unsigned context_groups = DEFAULT_CONTEXT_GROUPS;   // codes of the context format
+    unsigned symbol_width = 2;              // bytes per symbol of the symbol format
 };
 
-// Huffman Tree priority-value-assigning function
-int hnode_cmp(hnode * const & a, hnode * const & b) {
-    // return int > 0 if there are more letter a than letter b in a given string,
-    // or if letter a come after letter b in the aphabet. Otherwise,
-    // return int < 0
+// the slice of the original file uncompress was asked for
+struct output_range {
+    bool active = false;
+    uint64_t start = 0;
+    uint64_t length = UINT64_MAX;
+};
+
+void note_sample_cost(const unsigned char *data, size_t n, const unsigned char *lengths) {
+    // how many more bits the code built from a sample takes than the code of the
+    // whole file would have; the file is in the page cache by now, and its histogram
+    // gives the entropy as well
 
-    if (a->count > b->count) return 1;
-    if (a->count < b ->count) return -1;
-    return (a->character) - (b->character);
+    stats->count(data, n);
+    unsigned char exact[256];
+    make_code_lengths(stats->counts, exact, 0);
+    uint64_t exact_bits = 0, sampled_bits = 0;
+    for (int i = 0; i < 256; i++) {
+        exact_bits += stats->counts[i] * exact[i];
+        sampled_bits += stats->counts[i] * lengths[i];
+    }
+    stats->note("sample_cost_bits", sampled_bits - exact_bits);
+    stats->note("sample_cost_percent",
+                100.0 * (sampled_bits - exact_bits) / std::max<uint64_t>(exact_bits, 1));
 }
 
-bool show_bits = true;   // might be useful for debugging
+void note_limit_cost(const size_t *counts, const unsigned char *lengths) {
+    // how many more bits the limited code lengths take than the optimal ones
 
-int bits_to_byte(std::string bitstr) {
-    // a function to convert bit-string to byte
+    unsigned char optimal[256];
+    make_code_lengths(counts, optimal, 0);
+    uint64_t optimal_bits = 0, limited_bits = 0;
+    for (int i = 0; i < 256; i++) {
+        optimal_bits += counts[i] * optimal[i];
+        limited_bits += counts[i] * lengths[i];
+    }
+    stats->note("limit_cost_bits", limited_bits - optimal_bits);
+    stats->note("limit_cost_percent", 100.0 * (limited_bits - optimal_bits) / optimal_bits);
+}
 
-    int result = 0;
+void note_blocks(const unsigned char *data, size_t size,
+                 const std::vector<std::vector<unsigned char>> & frames, size_t count) {
+    // add a batch of blocks to the statistics: the bytes they code, and the
+    // headers, tables and bits of their frames
 
-    // For each bit in the bitstring, add 2^(index) to result if bit is "1"
-    for (size_t i = 0, v = 128; i < 8; i++, v /= 2) {
-        if (bitstr[i] == '1') {
-            result += v;
+    stats->count(data, size);
+    if (stats->bytes_in == STATS_UNKNOWN) {
+        stats->bytes_in = stats->original_bytes = stats->header_bytes = stats->payload_bits = 0;
+    }
+    stats->bytes_in += size;
+    stats->original_bytes += size;
+    for (size_t i = 0; i < count; i++) {
+        const unsigned char *frame = frames[i].data();
+        uint64_t bits = load_le(frame + 4, 4);
+        stats->header_bytes += block_bits_offset(frame);
+        stats->payload_bits += bits;
+        unsigned char lengths[256];
+        size_t table_size = load_le(frame + 8, 2) & ((1 << BLOCK_STREAMS_SHIFT) - 1);
+        if (block_type(frame) == BLOCK_CODED &&
+            read_code_lengths(frame + BLOCK_HEADER_SIZE, table_size, lengths, 256)) {
+            stats->add_code(lengths, bits, block_uncompressed_size(frame));
         }
     }
-    return result;
 }
 
-std::string byte_to_bits(int byte) {
-    // a function that convert byte to bit-string
+void compress_blocks(std::istream & in, const mapped_input & mapped,
+                     const compress_options & options) {
+    // Compress a stream as a sequence of independent blocks in a single pass.
+    // Batches of blocks are read into memory, encoded in parallel, and written
+    // out in order as soon as they are done, so memory stays bounded by the
+    // batch size and the input can be a pipe of any length. A mapped input
+    // file is encoded in place instead of being read.
 
-    std::string result = "";
-    size_t i;
-    int v;
-    for (i = 0, v = 128; i < 8; i++, v /= 2) {
+    phase_timer timer(stats, PHASE_CODING);
+    unsigned char header[BLOCKS_HEADER_SIZE] = {FORMAT_MAGIC[0], FORMAT_MAGIC[1], FORMAT_BLOCKS};
+    bool sync = options.index && options.sync_interval;
+    header[3] = (options.index ? BLOCKS_FLAG_INDEX : 0) | (sync ? BLOCKS_FLAG_SYNC : 0);
+    store_le(header + 4, options.block_size, 4);
+    std::cout.write(reinterpret_cast<char *>(header), BLOCKS_HEADER_SIZE);
 
-        if (byte >= v) {    // if the given byte can divide v, add "1" to the bitstring
-            result += '1';
-            byte -= v;
+    // remember where each frame goes for the index
+    block_index index;
+    index.sync_interval = sync ? options.sync_interval : 0;
+    uint64_t offset = BLOCKS_HEADER_SIZE;
+
+    thread_pool pool(options.threads);
+    const size_t block_size = options.block_size;
+    const size_t batch = pool.size() * 4;
+    std::vector<unsigned char> input(mapped.is_open() ? 0 : batch * block_size);
+    std::vector<std::vector<unsigned char>> frames(batch);
+    std::vector<std::vector<uint32_t>> sync_points(batch);
+
+    for (uint64_t consumed = 0; ; consumed += batch * block_size) {
+        const unsigned char *data;
+        size_t size;
+        if (mapped.is_open()) {
+            data = mapped.data() + std::min<uint64_t>(consumed, mapped.size());
+            size = std::min<uint64_t>(batch * block_size, mapped.size() - (data - mapped.data()));
         }
-        else {              // if the given byte cannot divide v, add "0"
-            result += '0';
+        else {
+            in.read(reinterpret_cast<char *>(input.data()), input.size());
+            data = input.data();
+            size = in.gcount();
         }
+        if (size == 0) break;
+        size_t count = (size + block_size - 1) / block_size;
+
+        std::atomic<bool> failed(false);
+        pool.run(count, [&](size_t i) {
+            size_t n = std::min(block_size, size - i * block_size);
+            sync_points[i].clear();
+            if (!encode_block(data + i * block_size, n, options.max_bits, options.streams,
+                              options.min_gain, frames[i], index.sync_interval, &sync_points[i])) {
+                failed = true;
+            }
+        });
+        if (failed) {
+            std::cerr << "compress: the characters do not fit in codes of "
+                      << options.max_bits << " bits" << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+        if (stats) note_blocks(data, size, frames, count);
+        for (size_t i = 0; i < count; i++) {
+            std::cout.write(reinterpret_cast<char *>(frames[i].data()), frames[i].size());
+            index.blocks.push_back({offset, load_le(frames[i].data() + 4, 4),
+                                    block_uncompressed_size(frames[i].data()), index.sync.size()});
+            index.sync.insert(index.sync.end(), sync_points[i].begin(), sync_points[i].end());
+            offset += frames[i].size();
+        }
+        std::cout.flush();
+    }
+
+    std::vector<unsigned char> end_marker(4);
+    if (options.index) write_block_index(index, offset + 4, end_marker);
+    std::cout.write(reinterpret_cast<char *>(end_marker.data()), end_marker.size());
+    if (stats) {
+        stats->header_bytes += BLOCKS_HEADER_SIZE + end_marker.size();
+        stats->bytes_out = offset + end_marker.size();
     }
-    return result;
 }
 
-void get_char_distribution(size_t *counts, size_t & size, std::istream & istr) {
-    // Given all characters read from istr, get the distribution of the
-    // characters, i.e.
-    // counts[k] = the number of occurrences of k in the istream.
-    // size is the number of characters read
+bool read_whole(std::istream & in, std::vector<unsigned char> & data) {
+    // append everything left in a stream to data
 
-    // reads the entire contents of a file
-    while (true) {
-        int ch = istr.get();
-        if (!istr) { break; }
+    const size_t chunk = 1 << 16;
+    while (in) {
+        size_t have = data.size();
+        data.resize(have + chunk);
+        in.read(reinterpret_cast<char *>(data.data()) + have, chunk);
+        data.resize(have + in.gcount());
+    }
+    return in.eof();
+}
 
-        // determines input size and counts the frequencies of all characters
-        if (ch > -1) {
-            counts[ch]++;
-            size++;
-        }
+bool read_input(const char *filename, std::vector<unsigned char> & data) {
+    // a whole file, or standard input for "-"
+
+    if (std::string(filename) == "-") return read_whole(std::cin, data);
+    std::ifstream in(filename, std::ios::binary);
+    return in && read_whole(in, data);
+}
+
+void load_table(const char *filename, huffman::shared_table & table) {
+    // read a table file written by compress --train
+
+    std::vector<unsigned char> file;
+    if (!read_input(filename, file)) {
+        std::cerr << "huffman: cannot read " << filename << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+    size_t result = table.load(file.data(), file.size());
+    if (huffman::is_error(result)) {
+        std::cerr << "huffman: " << filename << " is not a table file" << std::endl;
+        std::exit(EXIT_FAILURE);
     }
 }
 
-hnode * make_tree(size_t *counts) {
-    // Assemble a queue of Huffman trees into one Huffman tree
+void train(const char *table_file, char **samples, int count, unsigned max_bits) {
+    // count the bytes of every sample (standard input when there are none) and
+    // save the table of their code
 
-    min_heap<hnode *> queue(hnode_cmp);
+    huffman::shared_table table;
+    std::vector<unsigned char> data;
+    for (int i = 0; i < std::max(count, 1); i++) {
+        const char *filename = count > 0 ? samples[i] : "-";
+        data.clear();
+        if (!read_input(filename, data)) {
+            std::cerr << "compress: cannot read " << filename << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+        table.add_sample(data.data(), data.size());
+    }
 
-    // Add a node for each character found in the original file into a priority queue
-    for (int i = 0; i < 256; i++) {
-        if (counts[i] != 0) {
-            queue.add(new hnode(i, counts[i], nullptr, nullptr));
+    unsigned char file[huffman::TABLE_FILE_BOUND];
+    size_t size = table.train(max_bits);
+    if (!huffman::is_error(size)) size = table.save(file, sizeof(file));
+    std::ofstream out(table_file, std::ios::binary);
+    if (huffman::is_error(size) || !out.write(reinterpret_cast<char *>(file), size)) {
+        std::cerr << "compress: cannot write " << table_file << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+    if (stats) {
+        stats->format = "table file";
+        stats->bytes_out = size;
+        stats->note("table_id", table.id());
+    }
+}
+
+const unsigned char *open_whole(const char *filename, mapped_input & mapped,
+                                std::vector<unsigned char> & data, size_t & size) {
+    // map the file, or standard input redirected from one, or else read it whole into
+    // data; main has already turned a pipe away
+
+    bool piped = std::string(filename) == "-";
+    off_t offset = piped ? lseek(STDIN_FILENO, 0, SEEK_CUR) : 0;
+    if (piped ? offset < 0 || !mapped.open(STDIN_FILENO, offset) : !mapped.open(filename)) {
+        if (!read_input(filename, data)) {
+            std::cerr << "compress: cannot open " << filename << std::endl;
+            std::exit(EXIT_FAILURE);
         }
     }
+    size = mapped.is_open() ? mapped.size() : data.size();
+    return mapped.is_open() ? mapped.data() : data.data();
+}
+
+void compress_table(const char *filename, const compress_options & options) {
+    // the whole input in one pass with the codes of a shared table
+
+    huffman::shared_table table;
+    load_table(options.table_file, table);
+    mapped_input mapped;
+    std::vector<unsigned char> data;
+    size_t size;
+    const unsigned char *in = open_whole(filename, mapped, data, size);
 
-    // Tree-building algorithm:
-    // Repeatedly use the priority queue to retrieve two top nodes
-    // and combine them to make a tree. Then reinserting the tree into
-    // the queue until queue size is 1.
-    while (queue.size() > 1) {
-        hnode *left_h = queue.front();
-        queue.remove();
-        hnode *right_h = queue.front();
-        queue.remove();
-        queue.add(
-            new hnode(left_h->character, left_h->count + right_h->count, left_h, right_h)
-        );
+    huffman::options settings;
+    settings.times = timing();
+    huffman::encoder encoder(settings);
+    std::vector<unsigned char> out(huffman::compress_bound(size, table));
+    size_t n = encoder.compress(table, in, size, out.data(), out.size());
+    std::cout.write(reinterpret_cast<char *>(out.data()), n);
+    if (stats) {
+        stats->count(in, size);
+        stats->bytes_in = stats->original_bytes = size;
+        stats->bytes_out = n;
+        stats->note("table_id", table.id());
     }
+}
+
+template <typename Symbol>
+size_t compress_symbol_array(const unsigned char *in, size_t size, unsigned max_bits,
+                             std::vector<unsigned char> & out) {
+    // read the little-endian symbols of the file and let libhuffman code them
 
-    // The last node inside the queue is the Huffman tree.
-    hnode *result = queue.front();
-    queue.remove();
-    return result;
+    std::vector<Symbol> symbols(size / sizeof(Symbol));
+    for (size_t i = 0; i < symbols.size(); i++) {
+        symbols[i] = (Symbol)load_le(in + i * sizeof(Symbol), sizeof(Symbol));
+    }
+    out.resize(huffman::compress_symbols_bound(symbols.size()));
+    huffman::options settings;
+    settings.times = timing();
+    huffman::encoder encoder(settings);
+    return encoder.compress_symbols(symbols.data(), symbols.size(), out.data(), out.size(),
+                                    max_bits);
 }
 
-void make_codes(hnode *tree, std::string *codes, std::string code="") {
-    // builds an array of string encodings from a Huffman tree
+void compress_symbols(const char *filename, const compress_options & options) {
+    // the file is an array of 16-bit or 32-bit little-endian symbols, coded as such
 
-    // if is at leaf, record the path of the character into codes
-    if (!tree->left && !tree->right) {
-        codes[tree->character] = code;
-        return;
+    mapped_input mapped;
+    std::vector<unsigned char> data;
+    size_t size;
+    const unsigned char *in = open_whole(filename, mapped, data, size);
+    if (size % options.symbol_width != 0) {
+        std::cerr << "compress: the file is not a whole number of " << options.symbol_width
+                  << "-byte symbols" << std::endl;
+        std::exit(EXIT_FAILURE);
     }
 
-    // Cite: Remove last character from C++ string - Stack Overflow
-    // Desc: How to delete the last character in a string
-    // URL: https://stackoverflow.com/questions/2310939/
-    // remove-last-character-from-c-string
+    std::vector<unsigned char> out;
+    size_t n = options.symbol_width == 2 ?
+               compress_symbol_array<uint16_t>(in, size, options.max_bits, out) :
+               compress_symbol_array<uint32_t>(in, size, options.max_bits, out);
+    if (huffman::get_error(n) == huffman::ERROR_SYMBOL) {
+        // only 32-bit symbols can be too large: name the first one
+        size_t i = 0;
+        while (load_le(in + i, 4) < huffman::MAX_SYMBOLS) i += 4;
+        std::cerr << "compress: the symbol at byte " << i << " is " << load_le(in + i, 4)
+                  << "; --width 4 codes symbols below " << huffman::MAX_SYMBOLS << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+    if (huffman::is_error(n)) {
+        std::cerr << "compress: " << huffman::error_message(n) << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+    std::cout.write(reinterpret_cast<char *>(out.data()), n);
+    if (stats) {
+        stats->count(in, size);
+        stats->bytes_in = stats->original_bytes = size;
+        stats->bytes_out = n;
+        stats->note("symbol_width", options.symbol_width);
+    }
+}
 
-    // traverse through the tree and record the path as the program go.
-    // add "0" to the code if the character located on the left of the tree
-    // add "1" to the code if the character located on the right of the tree
-    code += '0';
-    make_codes(tree->left, codes, code);
-    code.pop_back();
-    code += '1';
-    make_codes(tree->right, codes, code);
+const char *format_name(unsigned format) {
+    // how the statistics name a format
+
+    switch (format) {
+        case FORMAT_LEGACY: return "legacy";
+        case FORMAT_CANONICAL: return "canonical";
+        case FORMAT_BLOCKS: return "blocks";
+        case FORMAT_TABLE: return "table";
+        case FORMAT_CONTEXT: return "context";
+        case FORMAT_SYMBOLS: return "symbols";
+        default: return "unknown";
+    }
 }
 
-void write_tree(hnode *tree, std::ostream & ostr) {
-    // write the character representation of a Huffman tree into
-    // the compressed file for later decompression
-    // example output: ILaILbLc
+void note_whole(const unsigned char *in, size_t size, const unsigned char *out, size_t n,
+                const compress_options & options) {
+    // the statistics of a format with one code: the histogram of the file, and the code
+    // read back from the header libhuffman wrote with the bits it takes
 
-    // Given a Huffman tree, write its representation into the compressed file.
-    if (!tree->left && !tree->right) {
-        // "L" is a leave, next to "L" is the character of the original file
-        ostr << 'L' << (char)tree->character;
+    stats->bytes_in = stats->original_bytes = size;
+    stats->bytes_out = n;
+    if (size == 0) return;
+    if (options.format == FORMAT_CONTEXT) {
+        // the order-0 histogram is the sum of the contexts', and the order-1
+        // entropy the sum of their entropies
+        std::vector<size_t> counts(256 * 256);
+        count_contexts(in, size, counts.data());
+        context_code code;
+        uint64_t file_size;
+        stats->header_bytes = read_context_header(out, n, code, file_size);
+        double entropy = 0;
+        uint64_t bits = 0;
+        for (int p = 0; p < 256; p++) {
+            const size_t *row = &counts[p * 256];
+            const unsigned char *lengths = code.groups[code.group_of[p]].lengths;
+            for (int c = 0; c < 256; c++) {
+                stats->counts[c] += row[c];
+                bits += row[c] * lengths[c];
+            }
+            entropy += entropy_bits(row);
+        }
+        if (code.single >= 0) bits = 0;
+        stats->counted = true;
+        stats->payload_bits = bits;
+        for (size_t g = 0; g < code.groups.size(); g++) {
+            stats->add_code(code.groups[g].lengths, g == 0 ? bits : 0, g == 0 ? size : 0);
+        }
+        stats->note("context_groups", code.groups.size());
+        stats->note("order1_entropy", entropy / size);
         return;
     }
+
+    file_code code;
+    stats->header_bytes = read_file_header(out, n, code);
+    if (options.sample_size && options.sample_size < size) {
+        note_sample_cost(in, size, code.lengths);
+    }
     else {
-        // "I" is internal node, all internal node have 2 branches because
-        // Huffman tree is a full-tree
-        ostr << 'I';
-        write_tree(tree->left, ostr);
-        write_tree(tree->right, ostr);
+        stats->count(in, size);
+    }
+    if (options.max_bits) note_limit_cost(stats->counts, code.lengths);
+    uint64_t bits = 0;
+    if (code.single < 0) {
+        for (int c = 0; c < 256; c++) bits += (uint64_t)stats->counts[c] * code.lengths[c];
+    }
+    stats->payload_bits = bits;
+    stats->add_code(code.lengths, bits, size);
+}
+
+void compress_whole(const char *filename, const compress_options & options) {
+    // The formats with one code for the whole file: libhuffman codes the mapped (or
+    // read) file into a mapping of standard output when it is a regular file, or else
+    // into a buffer of the largest size the output can take.
+
+    mapped_input mapped;
+    std::vector<unsigned char> data;
+    size_t size;
+    const unsigned char *in = open_whole(filename, mapped, data, size);
+
+    huffman::options settings;
+    settings.format = options.format == FORMAT_LEGACY ? huffman::OUTPUT_LEGACY :
+                      options.format == FORMAT_CANONICAL ? huffman::OUTPUT_CANONICAL :
+                      huffman::OUTPUT_CONTEXT;
+    settings.max_bits = options.max_bits;
+    settings.sample_size = options.sample_size;
+    settings.context_groups = options.context_groups;
+    settings.threads = options.threads;
+    settings.times = timing();
+    size_t bound = huffman::compress_bound(size, settings);
+
+    std::vector<unsigned char> buffer;
+    mapped_output direct;
+    std::cout.flush();
+    if (!direct.open(STDOUT_FILENO, bound)) buffer.resize(bound);
+    unsigned char *out = direct.is_open() ? direct.data() : buffer.data();
+    size_t n = huffman::compress(in, size, out, bound, settings);
+    if (huffman::is_error(n)) {
+        std::cerr << "compress: " << huffman::error_message(n) << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+    if (stats) note_whole(in, size, out, n, options);
+    if (direct.is_open()) direct.close(n);
+    else std::cout.write(reinterpret_cast<char *>(out), n);
+}
+
+void compress(const char *filename, const compress_options & options) {
+    // Create compresseion of a file such that the compressed file is
+    // smaller compared to its original size
+
+    if (stats) stats->format = format_name(options.format);
+    if (options.format == FORMAT_TABLE) {
+        compress_table(filename, options);
+        return;
+    }
+    if (options.format == FORMAT_SYMBOLS) {
+        compress_symbols(filename, options);
+        return;
+    }
+    if (options.format != FORMAT_BLOCKS) {
+        compress_whole(filename, options);
+        return;
+    }
+
+    // standard input can only be read once, which the block format needs
+    mapped_input mapped;
+    if (std::string(filename) == "-") {
+        // a file redirected to standard input can still be mapped
+        off_t offset = lseek(STDIN_FILENO, 0, SEEK_CUR);
+        if (offset >= 0) mapped.open(STDIN_FILENO, offset);
+        compress_blocks(std::cin, mapped, options);
         return;
     }
+
+    // map the file when possible, so it is not copied through a stream
+    mapped.open(filename);
+    std::ifstream in(filename, std::ios::binary);
+    if (!in) {
+        std::cerr << "compress: cannot open " << filename << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+    compress_blocks(in, mapped, options);
 }
 
-hnode * read_tree(std::istream & istr) {
-    // creates a Huffman tree by reading a characters representation of the tree.
-    // inverse of write_tree
+bool write_all_at(int fd, const unsigned char *data, size_t size, off_t offset) {
+    // pwrite until everything is written
 
-    int v = istr.get(); // use the tree in the compressed file to build the tree
+    while (size > 0) {
+        ssize_t n = pwrite(fd, data, size, offset);
+        if (n <= 0) return false;
+        data += n;
+        size -= n;
+        offset += n;
+    }
+    return true;
+}
 
-    // "L" is stand for leave, the character follow "L" is the character in the
-    // original file
-    if (v == 'L') return new hnode(istr.get(), 0, nullptr, nullptr);
+bool read_all_at(int fd, unsigned char *data, size_t size, off_t offset) {
+    // pread until everything is read
 
-    // "I" is an internal node, Huffman tree is a full tree:
-    // all internal nodes have 2 branches.
-    else {
-        hnode *left = read_tree(istr);
-        hnode *right = read_tree(istr);
-        return new hnode(left->character, 0, left, right);
+    while (size > 0) {
+        ssize_t n = pread(fd, data, size, offset);
+        if (n <= 0) return false;
+        data += n;
+        size -= n;
+        offset += n;
     }
+    return true;
 }
 
-void write_compress(std::istream & istr, std::string *codes, std::ostream & ostr) {
-    // reads all uncompressed characters from a file and
-    // generates compressed character output
+bool load_block_index(unsigned char flags, block_index & index, uint64_t & index_offset) {
+    // Read the block index of the compressed file on standard input with pread.
+    // Returns false when the input is not a regular file with an index.
 
-    std::string output = "";
+    struct stat in_stat;
+    if (!(flags & BLOCKS_FLAG_INDEX) || fstat(STDIN_FILENO, &in_stat) != 0 ||
+        !S_ISREG(in_stat.st_mode) ||
+        (uint64_t)in_stat.st_size < BLOCKS_HEADER_SIZE + BLOCK_TRAILER_SIZE) {
+        return false;
+    }
+    uint64_t file_size = in_stat.st_size;
+    unsigned char trailer[BLOCK_TRAILER_SIZE];
+    size_t count;
+    if (!read_all_at(STDIN_FILENO, trailer, BLOCK_TRAILER_SIZE, file_size - BLOCK_TRAILER_SIZE) ||
+        !read_block_trailer(trailer, file_size, index_offset, count)) {
+        return false;
+    }
 
-    // reads the entire contents of a file
-    while (true) {
-        int ch = istr.get();
-        if (!istr) break;
-        output += codes[ch];    // add the encoded path together to make a bit-string
+    std::vector<unsigned char> entries(file_size - BLOCK_TRAILER_SIZE - index_offset);
+    if (!read_all_at(STDIN_FILENO, entries.data(), entries.size(), index_offset) ||
+        !read_block_index(entries.data(), entries.size(), count, flags & BLOCKS_FLAG_SYNC, index)) {
+        std::cerr << "uncompress: corrupt block index" << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
 
-        // given a bit-string, convert it into byte to get
-        // corresponding unicode characters and add the
-        // character to the compressed file
-        if (output.size() >= 8) {
-        ostr << static_cast<char>(bits_to_byte(output));
-        output = output.substr(8, output.size());
+    // the frames lie back to back, the last one ends at the end marker
+    for (size_t i = 0; i < count; i++) {
+        uint64_t frame_end = i + 1 < count ? index.blocks[i + 1].offset : index_offset - 4;
+        if (index.blocks[i].offset >= frame_end) {
+            std::cerr << "uncompress: corrupt block index" << std::endl;
+            std::exit(EXIT_FAILURE);
         }
     }
+    return true;
+}
 
-    // Given a leftover bit-string with size less than 8 bits,
-    // pad zeros to bit-string to make it convertible to a unicode
-    // character
-    while (output.size() < 8) {
-        output += '0';
+bool uncompress_indexed(unsigned char flags, size_t block_size, thread_pool & pool) {
+    // Decode the blocks listed in the block index concurrently. The compressed
+    // file is mapped (or read with pread when it cannot be); when the output is
+    // a regular file, every block is decoded straight into a mapping of it, or
+    // written to its final position with pwrite, otherwise batches of decoded
+    // blocks are written in order. Returns false, without reading anything from
+    // std::cin, when the input is not a file with an index.
+
+    block_index blocks;
+    uint64_t index_offset;
+    if (!load_block_index(flags, blocks, index_offset)) return false;
+    const std::vector<block_index_entry> & index = blocks.blocks;
+    size_t count = index.size();
+
+    std::vector<uint64_t> output_offset(count + 1, 0);
+    for (size_t i = 0; i < count; i++) {
+        if (index[i].size > block_size) {
+            std::cerr << "uncompress: corrupt block index" << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+        output_offset[i + 1] = output_offset[i] + index[i].size;
+    }
+
+    mapped_input mapped;
+    mapped.open(STDIN_FILENO, 0);
+    auto decode = [&](size_t i, unsigned char *out) {
+        // find (or read) the frame of block i and decode it into out
+        static thread_local std::vector<unsigned char> buffer;
+        uint64_t frame_end = i + 1 < count ? index[i + 1].offset : index_offset - 4;
+        if (frame_end < index[i].offset) return false;
+        size_t frame_size = frame_end - index[i].offset;
+        const unsigned char *frame;
+        if (mapped.is_open()) {
+            if (frame_end > mapped.size()) return false;
+            frame = mapped.data() + index[i].offset;
+        }
+        else {
+            buffer.resize(frame_size);
+            if (!read_all_at(STDIN_FILENO, buffer.data(), frame_size, index[i].offset)) return false;
+            frame = buffer.data();
+        }
+        return frame_size >= BLOCK_HEADER_SIZE &&
+               load_le(frame + 4, 4) == index[i].bits &&
+               block_uncompressed_size(frame) == index[i].size &&
+               decode_block(frame, frame_size, out);
+    };
+    std::atomic<bool> failed(false);
+
+    mapped_output direct;
+    struct stat out_stat;
+    off_t base = lseek(STDOUT_FILENO, 0, SEEK_CUR);
+    bool positional = false;
+    if (!direct.open(STDOUT_FILENO, output_offset[count])) {
+        positional = fstat(STDOUT_FILENO, &out_stat) == 0 && S_ISREG(out_stat.st_mode) &&
+                     base >= 0 && !(fcntl(STDOUT_FILENO, F_GETFL) & O_APPEND) &&
+                     ftruncate(STDOUT_FILENO, base + output_offset[count]) == 0;
+    }
+    if (direct.is_open()) {
+        pool.run(count, [&](size_t i) {
+            if (!decode(i, direct.data() + output_offset[i])) failed = true;
+        });
+        direct.close();
+    }
+    else if (positional) {
+        pool.run(count, [&](size_t i) {
+            static thread_local std::vector<unsigned char> output;
+            output.resize(index[i].size);
+            if (!decode(i, output.data()) ||
+                !write_all_at(STDOUT_FILENO, output.data(), output.size(),
+                              base + output_offset[i])) {
+                failed = true;
+            }
+        });
+        lseek(STDOUT_FILENO, base + output_offset[count], SEEK_SET);
     }
-    ostr << static_cast<char>(bits_to_byte(output));
+    else {
+        const size_t batch = pool.size() * 4;
+        std::vector<std::vector<unsigned char>> outputs(batch);
+        for (size_t first = 0; first < count && !failed; first += batch) {
+            size_t n = std::min(batch, count - first);
+            pool.run(n, [&](size_t i) {
+                outputs[i].resize(index[first + i].size);
+                if (!decode(first + i, outputs[i].data())) failed = true;
+            });
+            for (size_t i = 0; i < n && !failed; i++) {
+                std::cout.write(reinterpret_cast<char *>(outputs[i].data()), outputs[i].size());
+            }
+        }
+    }
+    if (failed) {
+        std::cerr << "uncompress: corrupt compressed data" << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+    if (stats) stats->bytes_out = output_offset[count];
+    return true;
 }
 
-void compress(char *filename) {
-    // Create compresseion of a file such that the compressed file is
-    // smaller compared to its original size
+bool uncompress_range(unsigned char flags, size_t block_size, uint64_t start, uint64_t length) {
+    // Decode only the bytes [start, start + length) of the original file. The
+    // block index tells which blocks hold them and where their frames are; in
+    // each of those blocks, decoding starts at the last sync point before the
+    // slice and only the bits up to the next sync point after it are read.
+    // Returns false, without reading anything from std::cin, when the input is
+    // not a file with an index.
+
+    block_index index;
+    uint64_t index_offset;
+    if (!load_block_index(flags, index, index_offset)) return false;
+
+    const size_t interval = index.sync_interval;
+    uint64_t block_start = 0;
+    std::vector<unsigned char> frame, output;
+    decode_table table;
+    bool ok = true;
+    for (const block_index_entry & block : index.blocks) {
+        uint64_t block_end = block_start + block.size;
+        if (block.size > block_size) {
+            ok = false;
+            break;
+        }
+        if (block_end <= start || length == 0) {
+            block_start = block_end;
+            continue;
+        }
 
-    // open the file
-    std::ifstream in(filename);
-    size_t counts[256] = {}; // initializes all to zero.
-    size_t file_size = 0;
+        // the slice of this block and the sync points around it
+        uint64_t first = start - std::min(start, block_start);
+        uint64_t last = std::min<uint64_t>(block.size, start + length - block_start);
+        size_t from_sync = interval ? first / interval : 0;
+        size_t to_sync = interval ? (last + interval - 1) / interval : 1;
+        uint64_t from_bit = from_sync ? index.sync[block.first_sync + from_sync - 1] : 0;
+        uint64_t to_bit = to_sync <= index.sync_count(block.size)
+                        ? index.sync[block.first_sync + to_sync - 1] : block.bits;
+        uint64_t from = from_sync * interval;
+        if (from_bit > to_bit || to_bit > block.bits) {
+            ok = false;
+            break;
+        }
 
-    // find the file size and the distribution of each character in the file
-    get_char_distribution(counts, file_size, in);
-    in.close();
-    if (file_size == 0) return;
+        // read the header and table, then just the bytes holding the bits needed
+        frame.resize(BLOCK_HEADER_SIZE);
+        if (!read_all_at(STDIN_FILENO, frame.data(), BLOCK_HEADER_SIZE, block.offset)) {
+            ok = false;
+            break;
+        }
+        size_t bits_offset = block_bits_offset(frame.data());
+        size_t bytes = (to_bit + 7) / 8 - from_bit / 8;
+        frame.resize(bits_offset + bytes);
+        output.resize(last - from);
+        if (!read_all_at(STDIN_FILENO, frame.data() + BLOCK_HEADER_SIZE,
+                         bits_offset - BLOCK_HEADER_SIZE, block.offset + BLOCK_HEADER_SIZE) ||
+            !read_all_at(STDIN_FILENO, frame.data() + bits_offset, bytes,
+                         block.offset + bits_offset + from_bit / 8) ||
+            !decode_block_bits(frame.data(), table, frame.data() + bits_offset, bytes,
+                               from_bit % 8, output.data(), output.size())) {
+            ok = false;
+            break;
+        }
+        std::cout.write(reinterpret_cast<char *>(output.data()) + (first - from), last - first);
 
-    // create a Huffman tree using a priority queue, in which the file characters
-    // are sorted according to their values and distribution
-    hnode *tree = make_tree(counts);
-    std::string codes[256];
+        uint64_t done = block_start + last - start;
+        start += done;
+        length -= done;
+        block_start = block_end;
+    }
+    if (!ok) {
+        std::cerr << "uncompress: corrupt compressed data" << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+    return true;
+}
 
-    // create a bit-strings that encodes the location of the characters
-    // within the Huffman tree (0 is left node, 1 is right node)
-    make_codes(tree, codes);
+void uncompress_blocks(unsigned threads, const output_range & range) {
+    // Decode the block format. Files with a block index are decoded straight
+    // from the index; otherwise the frames are read in order until the end
+    // marker, and each batch of frames is decoded in parallel.
 
-    // enter the original file size into the compressed file
-    std::cout << file_size;
+    phase_timer timer(stats, PHASE_CODING);
+    unsigned char header[BLOCKS_HEADER_SIZE - 3];
+    std::cin.read(reinterpret_cast<char *>(header), sizeof(header));
+    unsigned char flags = header[0];
+    size_t block_size = load_le(header + 1, 4);
+    if (!std::cin || block_size > MAX_BLOCK_SIZE) {
+        std::cerr << "uncompress: corrupt header" << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
 
-    // enter the Huffman tree into the compressed file for later decompression
-    write_tree(tree, std::cout);
+    if (range.active && uncompress_range(flags, block_size, range.start, range.length)) return;
+    range_buffer filter(std::cout.rdbuf(), range.start, range.length);
+    if (range.active) std::cout.rdbuf(&filter);
 
-    // Second pass through the input....
-    in.open(filename);
+    thread_pool pool(threads);
+    if (!range.active && pool.size() > 1 && uncompress_indexed(flags, block_size, pool)) {
+        return;
+    }
 
-    // write the compressed file
-    write_compress(in, codes, std::cout);
+    // blocks that end before the range are read but not decoded, and no block is
+    // read once the range is complete
+    const size_t batch = pool.size() * 4;
+    std::vector<std::vector<unsigned char>> frames(batch);
+    std::vector<std::vector<unsigned char>> outputs(batch);
+    uint64_t written = 0;
+    bool done = false;
+    while (!done && !(range.active && filter.done())) {
+        // read frames until the batch is full or the end marker shows up
+        size_t count = 0;
+        for (; count < batch; count++) {
+            std::vector<unsigned char> & frame = frames[count];
+            frame.resize(BLOCK_HEADER_SIZE);
+            if (!std::cin.read(reinterpret_cast<char *>(frame.data()), 4)) break;
+            size_t size = block_uncompressed_size(frame.data());
+            if (size == 0) {
+                done = true;
+                break;
+            }
+            std::cin.read(reinterpret_cast<char *>(frame.data()) + 4, BLOCK_HEADER_SIZE - 4);
+            size_t frame_size = block_frame_size(frame.data());
+            frame.resize(frame_size);
+            std::cin.read(reinterpret_cast<char *>(frame.data()) + BLOCK_HEADER_SIZE,
+                          frame_size - BLOCK_HEADER_SIZE);
+            if (size > block_size) break;
+        }
+        if (!std::cin || (!done && count < batch)) {
+            std::cerr << "uncompress: corrupt compressed data" << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+
+        std::vector<uint64_t> ends(count);
+        for (size_t i = 0; i < count; i++) {
+            ends[i] = (i ? ends[i - 1] : written) + block_uncompressed_size(frames[i].data());
+        }
+        std::atomic<bool> failed(false);
+        pool.run(count, [&](size_t i) {
+            outputs[i].resize(block_uncompressed_size(frames[i].data()));
+            if (range.active && ends[i] <= range.start) return;
+            if (!decode_block(frames[i].data(), frames[i].size(), outputs[i].data())) {
+                failed = true;
+            }
+        });
+        if (failed) {
+            std::cerr << "uncompress: corrupt compressed data" << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+        for (size_t i = 0; i < count; i++) {
+            if (range.active && ends[i] <= range.start) {
+                filter.skip(outputs[i].size());
+            }
+            else {
+                std::cout.write(reinterpret_cast<char *>(outputs[i].data()), outputs[i].size());
+            }
+            written += outputs[i].size();
+        }
+    }
+    std::cout.rdbuf(filter.target());
+    if (stats) stats->bytes_out = written;
 }
 
-int read_bitstr(std::istream & istr, std::string & bitstr, hnode *tree) {
-    // reads a single “bit” from a file (using buffering) and
-    // uncompresses a stream of characters using a Huffman tree
+void note_header(const unsigned char *in, size_t size) {
+    // the header and code of a format with one code, from the start of the compressed data
 
-    // get a bit-string encoding using the characters from the compressed file
-    if (bitstr == "") {
-        int byte = istr.get();
-        bitstr += byte_to_bits(byte);
+    file_code code;
+    context_code context;
+    uint64_t file_size;
+    size_t head = read_file_header(in, size, code);
+    if (head) {
+        stats->header_bytes = head;
+        stats->add_code(code.lengths, 0, 0);
     }
+    else if ((head = read_context_header(in, size, context, file_size))) {
+        stats->header_bytes = head;
+        for (const context_group & group : context.groups) stats->add_code(group.lengths, 0, 0);
+        stats->note("context_groups", context.groups.size());
+    }
+}
 
-    // return character when reaching the leave of the tree
-    if (!tree->left && !tree->right) return tree->character;
+bool uncompress_mapped(const huffman::shared_table & table, unsigned threads) {
+    // When both standard input and standard output are regular files, map
+    // them and let libhuffman decode the one into the other, unless the blocks
+    // of the block format are to be decoded on several threads. Returns false,
+    // without reading anything from std::cin, when they cannot be mapped. The
+    // output file is sized to what the header claims only once decompressed_size
+    // has found that the input can hold it; a damaged size goes the way of a
+    // pipe, which stops at the first bits that do not decode.
 
-    // the binary string tell where to search for origianl characters in the tree,
-    // i.e.: "0" is left of the tree and "1" is right of the tree
-    if (bitstr[0] == '0') tree = tree->left;
-    if (bitstr[0] == '1') tree = tree->right;
+    mapped_input in;
+    std::streamoff position = std::cin.tellg();
+    if (position < 0 || !in.open(STDIN_FILENO, position)) return false;
+    const unsigned char *magic = in.data();
+    bool blocks = in.size() >= 3 && magic[0] == FORMAT_MAGIC[0] && magic[2] == FORMAT_BLOCKS;
+    if (blocks && threads != 1) return false;
+    size_t size = huffman::decompressed_size(in.data(), in.size());
+    if (huffman::is_error(size)) return false;
+    mapped_output out;
+    if (!out.open(STDOUT_FILENO, size)) return false;
 
-    // move on to next character in the binary string as searching continue
-    bitstr = bitstr.substr(1, bitstr.size());
-    return read_bitstr(istr, bitstr, tree);
+    if (stats) {
+        stats->format = format_name(magic[0] != FORMAT_MAGIC[0] ? FORMAT_LEGACY : magic[2]);
+        stats->bytes_out = size;
+        note_header(in.data(), in.size());
+    }
+    huffman::decoder decoder(timing());
+    size_t result = decoder.decompress(table, in.data(), in.size(), out.data(), size);
+    if (huffman::is_error(result) || result != size) {
+        std::cerr << "uncompress: " << huffman::error_message(result) << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+    return true;
 }
 
-void write_uncompress(std::istream & istr, size_t file_size, hnode * tree) {
-    // Given a bit-string of arbitrary length, buffers the bits into blocks
-    // of 8 (a byte) to the binary encoding of a unicode character
+void uncompress_stream(const unsigned char *head, size_t head_size, const output_range & range) {
+    // The formats with one code for the whole file, from a pipe: a stream_decoder
+    // takes standard input a chunk at a time, starting with head (what was read of
+    // it to tell the format), and its output goes to std::cout, cut to the range.
+
+    range_buffer filter(std::cout.rdbuf(), range.start, range.length);
+    if (range.active) std::cout.rdbuf(&filter);
+    const size_t chunk = 1 << 20;
+    huffman::stream_decoder decoder(chunk, timing());
+    std::vector<unsigned char> input(chunk), output(chunk);
+    std::copy(head, head + head_size, input.begin());
+    std::cin.read(reinterpret_cast<char *>(input.data()) + head_size, chunk - head_size);
+    size_t have = head_size + std::cin.gcount();
+    size_t used = 0;
+    if (stats) note_header(input.data(), have);
 
-    std::string buffers = "";
-    for (size_t i = 0; i < file_size; i++) {
-        hnode *reader = tree;
+    uint64_t written = 0;
+    bool finished = false;
+    while (!decoder.done() && !(range.active && filter.done())) {
+        if (used == have && std::cin) {
+            std::cin.read(reinterpret_cast<char *>(input.data()), chunk);
+            have = std::cin.gcount();
+            used = 0;
+        }
+        if (used == have && !std::cin && !finished) {
+            decoder.finish();
+            finished = true;
+        }
+        used += decoder.feed(input.data() + used, have - used);
+        size_t n = decoder.drain(output.data(), output.size());
+        if (!huffman::is_error(n) && n == 0 && finished && !decoder.done()) {
+            n = (size_t)0 - huffman::ERROR_CORRUPT;
+        }
+        if (huffman::is_error(n)) {
+            std::cerr << "uncompress: " << huffman::error_message(n) << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+        std::cout.write(reinterpret_cast<char *>(output.data()), n);
+        written += n;
+    }
+    std::cout.rdbuf(filter.target());
+    if (stats) stats->bytes_out = written;
+}
 
-        // read each characters in the compressed file
-        // and translate them to binary strings
-        int ch = read_bitstr(istr, buffers, reader);
-        std::cout << static_cast<char>(ch);
+void uncompress_whole(const unsigned char *magic, const huffman::shared_table & table) {
+    // the table format is for small files, and the symbol format codes whole arrays:
+    // read them whole and let libhuffman decode them
+
+    std::vector<unsigned char> data(magic, magic + 3);
+    if (magic[2] == FORMAT_TABLE && !table.ready()) {
+        std::cerr << "uncompress: the file needs the shared table it was compressed with"
+                  << " (--table FILE)" << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+    if (!read_whole(std::cin, data)) {
+        std::cerr << "uncompress: cannot read the compressed data" << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+    size_t size = huffman::decompressed_size(data.data(), data.size());
+    std::vector<unsigned char> out;
+    if (!huffman::is_error(size)) {
+        out.resize(size);
+        huffman::decoder decoder(timing());
+        size = decoder.decompress(table, data.data(), data.size(), out.data(), out.size());
+    }
+    if (stats && !huffman::is_error(size)) {
+        stats->bytes_out = size;
+        if (magic[2] == FORMAT_TABLE) stats->note("table_id", table.id());
+    }
+    if (huffman::is_error(size)) {
+        std::cerr << "uncompress: " << huffman::error_message(size) << std::endl;
+        std::exit(EXIT_FAILURE);
     }
+    std::cout.write(reinterpret_cast<char *>(out.data()), size);
 }
 
-void uncompress() {
+void uncompress(unsigned threads, const output_range & range, const huffman::shared_table & table) {
     // decode the compressed file and recreate the original file
     // from the compressed file
 
     if (std::cin.peek() == EOF) return;  // handle empty file
-    size_t file_size;
-    std::cin >> file_size;
-    hnode *tree = read_tree(std::cin);
-    write_uncompress(std::cin, file_size, tree);
+
+    // a whole file decoded on one thread is a single library call
+    if (!range.active && uncompress_mapped(table, threads)) return;
+
+    // the original format starts with a digit, versioned formats with a magic
+    if (std::cin.peek() != FORMAT_MAGIC[0]) {
+        if (stats) stats->format = format_name(FORMAT_LEGACY);
+        uncompress_stream(nullptr, 0, range);
+        return;
+    }
+    unsigned char magic[3];
+    std::cin.read(reinterpret_cast<char *>(magic), 3);
+    if (!std::cin || magic[1] != FORMAT_MAGIC[1]) magic[2] = FORMAT_LEGACY;
+    if (stats) stats->format = format_name(magic[2]);
+
+    // Without a block index, the only way to a slice is to decode everything
+    // before it: the filter drops what is outside the range, and the decoders
+    // stop once it has the whole range.
+    range_buffer filter(std::cout.rdbuf(), range.start, range.length);
+    switch (magic[2]) {
+        case FORMAT_CANONICAL:
+        case FORMAT_CONTEXT:
+            uncompress_stream(magic, 3, range);
+            break;
+        case FORMAT_BLOCKS:
+            uncompress_blocks(threads, range);
+            break;
+        case FORMAT_TABLE:
+        case FORMAT_SYMBOLS:
+            if (range.active) std::cout.rdbuf(&filter);
+            uncompress_whole(magic, table);
+            std::cout.rdbuf(filter.target());
+            break;
+        default:
+            std::cerr << "uncompress: unknown file format" << std::endl;
+            std::exit(EXIT_FAILURE);
+    }
 }
 
 bool ends_with(const std::string & str, const std::string & suffix) {
@@ -316,21 +1019,246 @@ bool is_compress(const std::string & command) {
            !ends_with(command, "uncompress");
 }
 
+bool parse_size(const std::string & text, uint64_t & size) {
+    // a byte count with an optional K, M or G suffix
+
+    char *end;
+    size = std::strtoull(text.c_str(), &end, 10);
+    if (end == text.c_str()) return false;
+    switch (*end) {
+        case 'K': case 'k': size <<= 10, end++; break;
+        case 'M': case 'm': size <<= 20, end++; break;
+        case 'G': case 'g': size <<= 30, end++; break;
+    }
+    return *end == '\0';
+}
+
+bool parse_stats(const std::string & option, stats_output & output) {
+    // -b, --stats and --stats=text report as text, --stats=json as JSON
+
+    if (option == "-b" || option == "--stats" || option == "--stats=text") output = STATS_TEXT;
+    else if (option == "--stats=json") output = STATS_JSON;
+    else return false;
+    return true;
+}
+
+bool is_regular_file(int fd) {
+    struct stat file_stat;
+    return fstat(fd, &file_stat) == 0 && S_ISREG(file_stat.st_mode);
+}
+
+uint64_t input_size() {
+    // bytes left on standard input, when it is a regular file
+
+    struct stat in_stat;
+    off_t offset = lseek(STDIN_FILENO, 0, SEEK_CUR);
+    if (offset < 0 || fstat(STDIN_FILENO, &in_stat) != 0 || !S_ISREG(in_stat.st_mode)) {
+        return STATS_UNKNOWN;
+    }
+    return in_stat.st_size - offset;
+}
+
+void usage() {
+    // print how to run the program and quit
+
+    std::cerr << "usage: compress [--stats[=json]] [-c] [-l bits] [-B size] [-j threads] [--no-index]"
+              << " [--sync size]" << std::endl
+              << "                [--streams N] [--min-gain P] [--sample size] [--table table]"
+              << " [-1] [--contexts N]" << std::endl
+              << "                [--width 2|4]" << std::endl
+              << "                [file] > file.z"
+              << std::endl
+              << "       compress --train table [-l bits] [sample ...]" << std::endl
+              << "       uncompress [--stats[=json]] [-j threads] [--range start:length]"
+              << " [--table table] < file.z > file" << std::endl
+              << "  -b, --stats         report timings, sizes and the code on standard error"
+              << std::endl
+              << "  --stats=json        the same as one JSON object" << std::endl
+              << "  -c, --canonical     store canonical code lengths instead of the tree" << std::endl
+              << "  -l, --max-bits N    limit codes to N bits (1-" << CANONICAL_MAX_BITS
+              << "), implies -c" << std::endl
+              << "  -B, --block-size N  code blocks of N bytes (suffix K or M, "
+              << (MIN_BLOCK_SIZE >> 10) << "K-" << (MAX_BLOCK_SIZE >> 20) << "M) on their own"
+              << std::endl
+              << "  -j, --threads N     compress blocks on N threads (default: all cores)," << std::endl
+              << "                      or uncompress them on N threads (default: 1, 0: all cores)"
+              << std::endl
+              << "  --no-index          leave the block index out of the block format" << std::endl
+              << "  --sync N            add a sync point every N bytes of a block to the index"
+              << std::endl
+              << "  --streams N         split every block into N streams decoded side by side (1-"
+              << MAX_STREAMS << ", default " << DEFAULT_STREAMS << ")" << std::endl
+              << "  --min-gain P        store blocks that coding would not shrink by P percent"
+              << " (default " << DEFAULT_MIN_GAIN << ")" << std::endl
+              << "  --sample N          build the code from N bytes spread over the file (sizes"
+              << " take K, M, G)" << std::endl
+              << "  --train FILE        save a code trained on the samples to the table file FILE"
+              << std::endl
+              << "  --table FILE        code with the table in FILE instead of a code of the file's"
+              << " own" << std::endl
+              << "  -1, --order1        code every byte with a code chosen by the byte before it"
+              << std::endl
+              << "  --contexts N        share the codes of -1 among N groups of contexts (1-"
+              << MAX_CONTEXT_GROUPS << ", default " << DEFAULT_CONTEXT_GROUPS << "), implies -1"
+              << std::endl
+              << "  --width W           code the file as W-byte little-endian symbols (2 or 4,"
+              << " each below " << huffman::MAX_SYMBOLS << ")" << std::endl
+              << "  --range S:L         uncompress only L bytes starting at byte S (sizes take"
+              << " K, M, G)" << std::endl
+              << "  -B, -j, --sync, --streams and --min-gain select the block format. Without a"
+              << std::endl
+              << "  file, or with -, standard input is compressed in a single pass with the block"
+              << std::endl
+              << "  format; the other formats read their input whole, so they take a file (or"
+              << std::endl << "  standard input redirected from one) but not a pipe." << std::endl;
+    std::exit(EXIT_FAILURE);
+}
+
 int main(int argc, char **argv) {
     // main
 
-    assert(argc == argc);
+    std::ios::sync_with_stdio(false);   // only iostreams are used, in large pieces
+
+    std::unique_ptr<run_stats> report;
+    stats_output output;
     if (is_compress(argv[0])) {
-        if (std::string(argv[1]) == "-b") {
-            show_bits = true;
-            compress(argv[2]);
+        compress_options options;
+        const char *train_file = nullptr;
+        int i = 1;
+        for (; i < argc && argv[i][0] == '-' && argv[i][1] != '\0'; i++) {
+            std::string option = argv[i];
+            bool has_value = i + 1 < argc;
+            if (parse_stats(option, output)) report.reset(new run_stats("compress", output));
+            else if (option == "-c" || option == "--canonical") {
+                if (options.format == FORMAT_LEGACY) options.format = FORMAT_CANONICAL;
+            }
+            else if ((option == "-l" || option == "--max-bits") && has_value) {
+                options.max_bits = std::atoi(argv[++i]);
+                if (options.max_bits < 1 || options.max_bits > CANONICAL_MAX_BITS) usage();
+                if (options.format == FORMAT_LEGACY) options.format = FORMAT_CANONICAL;
+            }
+            else if ((option == "-B" || option == "--block-size") && has_value) {
+                uint64_t size;
+                if (!parse_size(argv[++i], size) || size < MIN_BLOCK_SIZE || size > MAX_BLOCK_SIZE) {
+                    usage();
+                }
+                options.block_size = size;
+                options.format = FORMAT_BLOCKS;
+            }
+            else if (option == "--sync" && has_value) {
+                uint64_t size;
+                if (!parse_size(argv[++i], size) || size == 0 || size > MAX_BLOCK_SIZE) usage();
+                options.sync_interval = size;
+                options.format = FORMAT_BLOCKS;
+            }
+            else if ((option == "-j" || option == "--threads") && has_value) {
+                options.threads = std::atoi(argv[++i]);
+                options.format = FORMAT_BLOCKS;
+            }
+            else if (option == "--streams" && has_value) {
+                options.streams = std::atoi(argv[++i]);
+                if (options.streams < 1 || options.streams > MAX_STREAMS) usage();
+                options.format = FORMAT_BLOCKS;
+            }
+            else if (option == "--min-gain" && has_value) {
+                char *end;
+                unsigned long percent = std::strtoul(argv[++i], &end, 10);
+                if (*end != '\0' || end == argv[i] || percent > 99) usage();
+                options.min_gain = (unsigned)percent;
+                options.format = FORMAT_BLOCKS;
+            }
+            else if (option == "--sample" && has_value) {
+                uint64_t size;
+                if (!parse_size(argv[++i], size) || size == 0) usage();
+                options.sample_size = size;
+            }
+            else if (option == "-1" || option == "--order1") options.format = FORMAT_CONTEXT;
+            else if (option == "--contexts" && has_value) {
+                options.context_groups = std::atoi(argv[++i]);
+                if (options.context_groups < 1 || options.context_groups > MAX_CONTEXT_GROUPS) {
+                    usage();
+                }
+                options.format = FORMAT_CONTEXT;
+            }
+            else if (option == "--width" && has_value) {
+                options.symbol_width = std::atoi(argv[++i]);
+                if (options.symbol_width != 2 && options.symbol_width != 4) usage();
+                options.format = FORMAT_SYMBOLS;
+            }
+            else if (option == "--table" && has_value) options.table_file = argv[++i];
+            else if (option == "--train" && has_value) train_file = argv[++i];
+            else if (option == "--no-index") options.index = false;
+            else usage();
         }
-        else {
-            compress(argv[1]);
+        stats = report.get();
+        if (train_file) {
+            train(train_file, argv + i, argc - i, options.max_bits);
+            if (stats) report_stats(*stats, std::cerr);
+            return 0;
+        }
+        if (i < argc - 1) usage();
+        const char *filename = i < argc ? argv[i] : "-";
+        if (options.table_file) options.format = FORMAT_TABLE;
+        if (std::string(filename) == "-" && options.format == FORMAT_LEGACY &&
+            !options.sample_size) {
+            options.format = FORMAT_BLOCKS;
+        }
+        if (std::string(filename) == "-" && options.format != FORMAT_BLOCKS &&
+            !is_regular_file(STDIN_FILENO)) {
+            // every other format reads all of its input before writing any of it
+            std::cerr << "compress: only the block format is written from a pipe; give -c, -l,"
+                      << " -1, --sample, --table and --width a file" << std::endl;
+            std::exit(EXIT_FAILURE);
         }
+
+        // Reading a pipe and writing the output go on threads of their own, so
+        // the coder does not wait for either. A regular file is mapped instead.
+        pipelined_streams pipeline(std::string(filename) == "-" && !is_regular_file(STDIN_FILENO),
+                                   true);
+        compress(filename, options);
+        pipeline.finish();
     }
     else {
-        uncompress();
+        unsigned threads = 1;
+        output_range range;
+        huffman::shared_table table;
+        for (int i = 1; i < argc; i++) {
+            std::string option = argv[i];
+            if ((option == "-j" || option == "--threads") && i + 1 < argc) {
+                threads = std::atoi(argv[++i]);
+            }
+            else if (option == "--range" && i + 1 < argc) {
+                std::string value = argv[++i];
+                size_t colon = value.find(':');
+                if (colon == std::string::npos ||
+                    !parse_size(value.substr(0, colon), range.start) ||
+                    !parse_size(value.substr(colon + 1), range.length)) {
+                    usage();
+                }
+                range.active = true;
+            }
+            else if (option == "--table" && i + 1 < argc) load_table(argv[++i], table);
+            else if (parse_stats(option, output)) report.reset(new run_stats("uncompress", output));
+            else usage();
+        }
+        stats = report.get();
+        if (stats) stats->bytes_in = input_size();
+
+        // the output is mapped when it is a regular file, and decoded into directly
+        pipelined_streams pipeline(!is_regular_file(STDIN_FILENO),
+                                   !is_regular_file(STDOUT_FILENO));
+        uncompress(threads, range, table);
+        pipeline.finish();
+        if (stats) stats->original_bytes = stats->bytes_out;
+    }
+    if (stats) {
+        std::cout.flush();
+        for (int p = 0; p < PHASE_COUNT; p++) {
+            if (!library_times.timed[p]) continue;
+            stats->seconds[p] += library_times.seconds[p];
+            stats->timed[p] = true;
+        }
+        report_stats(*stats, std::cerr);
     }
 
 }
@@ -0,0 +1,112 @@
+/***************************************************************************************************
+    File: mappedFile.cc
+
+    Description:
+        Mapping and unmapping of input and output files.
+
+***************************************************************************************************/
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "mappedFile.h"
+
+bool mapped_input::open(const char *filename) {
+    // map the whole file by name
+
+    int fd = ::open(filename, O_RDONLY);
+    if (fd < 0) return false;
+    bool mapped = open(fd, 0);
+    ::close(fd);
+    return mapped;
+}
+
+bool mapped_input::open(int fd, uint64_t offset) {
+    // map from the page holding offset to the end of the file
+
+    close();
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || (uint64_t)info.st_size <= offset) {
+        return false;
+    }
+    uint64_t page = sysconf(_SC_PAGESIZE);
+    uint64_t start = offset / page * page;
+    size_t map_size = info.st_size - start;
+    void *map = mmap(nullptr, map_size, PROT_READ, MAP_PRIVATE, fd, start);
+    if (map == MAP_FAILED) return false;
+    madvise(map, map_size, MADV_SEQUENTIAL);
+
+    _map = map;
+    _map_size = map_size;
+    _data = static_cast<const unsigned char *>(map) + (offset - start);
+    _size = info.st_size - offset;
+    return true;
+}
+
+void mapped_input::close() {
+    // drop the mapping
+
+    if (_map) munmap(_map, _map_size);
+    _map = nullptr;
+    _map_size = 0;
+    _data = nullptr;
+    _size = 0;
+}
+
+bool mapped_output::open(int fd, uint64_t size) {
+    // A descriptor opened by the shell with > is write-only, which mmap cannot
+    // use, so the same file is opened again for reading and writing.
+
+    close();
+    struct stat info;
+    int flags = fcntl(fd, F_GETFL);
+    off_t base = lseek(fd, 0, SEEK_CUR);
+    if (size == 0 || fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || flags < 0 ||
+        (flags & O_APPEND) || base < 0) {
+        return false;
+    }
+    int rw = ::open(("/proc/self/fd/" + std::to_string(fd)).c_str(), O_RDWR);
+    if (rw < 0) return false;
+
+    uint64_t page = sysconf(_SC_PAGESIZE);
+    uint64_t start = base / page * page;
+    size_t map_size = base + size - start;
+    void *map = MAP_FAILED;
+    if (ftruncate(rw, base + size) == 0) {
+        map = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, rw, start);
+    }
+    if (map == MAP_FAILED) {
+        ::close(rw);
+        return false;
+    }
+    madvise(map, map_size, MADV_SEQUENTIAL);
+
+    _fd = rw;
+    _target = fd;
+    _map = map;
+    _map_size = map_size;
+    _data = static_cast<unsigned char *>(map) + (base - start);
+    _base = base;
+    _end = base + size;
+    return true;
+}
+
+void mapped_output::close(uint64_t size) {
+    if (!_map) return;
+    if (ftruncate(_fd, _base + size) == 0) _end = _base + size;
+    close();
+}
+
+void mapped_output::close() {
+    // unmap, and leave the descriptor where a write of the output would have
+
+    if (!_map) return;
+    munmap(_map, _map_size);
+    ::close(_fd);
+    lseek(_target, _end, SEEK_SET);
+    _fd = _target = -1;
+    _map = nullptr;
+    _map_size = 0;
+    _data = nullptr;
+}
@@ -0,0 +1,82 @@
+/***************************************************************************************************
+    File: mappedFile.h
+
+    Description:
+        Memory-mapped files. mapped_input maps a whole file (or what is left of it after the
+        current offset of a descriptor) read-only, with a hint that it will be read in order,
+        so the passes over the input touch the page cache directly instead of copying through
+        a stream. mapped_output maps a regular file for writing once the size of the output
+        is known, so a decoder can write its bytes straight into the file. Both fail quietly
+        on pipes, terminals and anything else that cannot be mapped; the caller then falls
+        back to buffered reads and writes.
+
+***************************************************************************************************/
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+
+class mapped_input {
+    private:
+        void *_map;                 // the mapping, nullptr when nothing is mapped
+        size_t _map_size;           // length of the mapping
+        const unsigned char *_data; // first byte of the input inside the mapping
+        size_t _size;               // bytes of input
+
+    public:
+        mapped_input() : _map(nullptr), _map_size(0), _data(nullptr), _size(0) {}
+        ~mapped_input() { close(); }
+
+        mapped_input(const mapped_input &) = delete;
+        mapped_input & operator=(const mapped_input &) = delete;
+
+        // map a file by name. Returns false if it cannot be mapped or is empty.
+        bool open(const char *filename);
+
+        // map the regular file behind fd from offset to its end
+        bool open(int fd, uint64_t offset);
+
+        void close();
+
+        bool is_open() const { return _map != nullptr; }
+        const unsigned char *data() const { return _data; }
+        size_t size() const { return _size; }
+};
+
+class mapped_output {
+    private:
+        int _fd;                    // descriptor the mapping was made through, -1 if none
+        int _target;                // descriptor whose offset moves past the output
+        void *_map;
+        size_t _map_size;
+        unsigned char *_data;       // first byte of the output inside the mapping
+        uint64_t _base;             // file offset of the output
+        uint64_t _end;              // file offset just past the output
+
+    public:
+        mapped_output()
+            : _fd(-1), _target(-1), _map(nullptr), _map_size(0), _data(nullptr), _base(0),
+              _end(0) {}
+        ~mapped_output() { close(); }
+
+        mapped_output(const mapped_output &) = delete;
+        mapped_output & operator=(const mapped_output &) = delete;
+
+        // size the regular file behind fd to hold size more bytes at its current offset
+        // and map them. Returns false (changing nothing) for anything but a regular file
+        // open for writing without O_APPEND, or an empty output.
+        bool open(int fd, uint64_t size);
+
+        // unmap and move the offset of the descriptor past the output
+        void close();
+
+        // same, keeping only the first size bytes of the output, for output whose size
+        // was only bounded when it was opened
+        void close(uint64_t size);
+
+        bool is_open() const { return _map != nullptr; }
+        unsigned char *data() { return _data; }
+};
+
+#endif
@@ -0,0 +1,181 @@
+/***************************************************************************************************
+    File: pipeline.cc
+
+    Description:
+        The reader and writer stages of the pipelined streams.
+
+***************************************************************************************************/
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include "pipeline.h"
+
+namespace {
+
+template <typename Ready>
+void wait_for(Ready ready) {
+    // yield a few times, as the other stage is usually about to be done, then sleep
+    // in steps that grow to a fifth of a millisecond
+
+    unsigned tries = 0;
+    std::chrono::microseconds pause(5);
+    while (!ready()) {
+        if (++tries < 64) std::this_thread::yield();
+        else {
+            std::this_thread::sleep_for(pause);
+            pause = std::min(pause * 2, std::chrono::microseconds(200));
+        }
+    }
+}
+
+}
+
+prefetch_buffer::prefetch_buffer(std::streambuf *source)
+    : _source(source), _buffers(PIPELINE_DEPTH, std::vector<char>(CHUNK_SIZE)),
+      _full(PIPELINE_DEPTH), _free(PIPELINE_DEPTH), _current{0, 0}, _holding(false),
+      _ended(false), _stop(false) {
+    for (size_t i = 0; i < PIPELINE_DEPTH; i++) _free.try_push({i, 0});
+    _reader = std::thread(&prefetch_buffer::_read_main, this);
+}
+
+prefetch_buffer::~prefetch_buffer() {
+    // a read in progress has to finish before the thread can stop
+
+    _stop = true;
+    _reader.join();
+}
+
+void prefetch_buffer::_read_main() {
+    // fill free chunks until the source ends, and pass on the empty chunk that says so
+
+    pipeline_chunk chunk;
+    for (;;) {
+        wait_for([&] { return _stop || _free.try_pop(chunk); });
+        if (_stop) return;
+        chunk.size = _source->sgetn(_buffers[chunk.buffer].data(), CHUNK_SIZE);
+        wait_for([&] { return _full.try_push(chunk); });
+        if (chunk.size == 0) return;
+    }
+}
+
+prefetch_buffer::int_type prefetch_buffer::underflow() {
+    // give the chunk that was read back to the reader and take the next one
+
+    if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+    if (_ended) return traits_type::eof();
+    if (_holding) {
+        wait_for([&] { return _free.try_push(_current); });
+        _holding = false;
+    }
+    wait_for([&] { return _full.try_pop(_current); });
+    if (_current.size == 0) {
+        _ended = true;
+        setg(nullptr, nullptr, nullptr);
+        return traits_type::eof();
+    }
+    _holding = true;
+    char *data = _buffers[_current.buffer].data();
+    setg(data, data, data + _current.size);
+    return traits_type::to_int_type(*gptr());
+}
+
+async_buffer::async_buffer(std::streambuf *target)
+    : _target(target), _buffers(PIPELINE_DEPTH, std::vector<char>(CHUNK_SIZE)),
+      _full(PIPELINE_DEPTH), _free(PIPELINE_DEPTH), _current{0, 0}, _finished(false) {
+    for (size_t i = 1; i < PIPELINE_DEPTH; i++) _free.try_push({i, 0});
+    setp(_buffers[0].data(), _buffers[0].data() + CHUNK_SIZE);
+    _writer = std::thread(&async_buffer::_write_main, this);
+}
+
+async_buffer::~async_buffer() {
+    finish();
+}
+
+void async_buffer::_write_main() {
+    // write out chunks in order until the empty chunk that ends the stream
+
+    pipeline_chunk chunk;
+    for (;;) {
+        wait_for([&] { return _full.try_pop(chunk); });
+        if (chunk.size == 0) return;
+        _target->sputn(_buffers[chunk.buffer].data(), chunk.size);
+        wait_for([&] { return _free.try_push(chunk); });
+    }
+}
+
+void async_buffer::_hand_over() {
+    // an empty put area stays where it is, as an empty chunk would end the stream
+
+    _current.size = pptr() - pbase();
+    if (_current.size == 0) return;
+    wait_for([&] { return _full.try_push(_current); });
+    wait_for([&] { return _free.try_pop(_current); });
+    char *data = _buffers[_current.buffer].data();
+    setp(data, data + CHUNK_SIZE);
+}
+
+async_buffer::int_type async_buffer::overflow(int_type ch) {
+    _hand_over();
+    if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(ch);
+        pbump(1);
+    }
+    return traits_type::not_eof(ch);
+}
+
+std::streamsize async_buffer::xsputn(const char *data, std::streamsize n) {
+    // copy into the put area a chunk at a time
+
+    std::streamsize left = n;
+    while (left > 0) {
+        if (pptr() == epptr()) _hand_over();
+        std::streamsize part = std::min<std::streamsize>(left, epptr() - pptr());
+        std::memcpy(pptr(), data, part);
+        pbump((int)part);
+        data += part;
+        left -= part;
+    }
+    return n;
+}
+
+int async_buffer::sync() {
+    // pass on what was written so far; the writer gets to it in its turn
+
+    _hand_over();
+    return 0;
+}
+
+void async_buffer::finish() {
+    if (_finished) return;
+    _finished = true;
+    _hand_over();
+    pipeline_chunk end = {0, 0};
+    wait_for([&] { return _full.try_push(end); });
+    _writer.join();
+    _target->pubsync();
+}
+
+pipelined_streams::pipelined_streams(bool input, bool output) {
+    if (input) {
+        _input.reset(new prefetch_buffer(std::cin.rdbuf()));
+        std::cin.rdbuf(_input.get());
+    }
+    if (output) {
+        _output.reset(new async_buffer(std::cout.rdbuf()));
+        std::cout.rdbuf(_output.get());
+    }
+}
+
+void pipelined_streams::finish() {
+    if (_output) {
+        std::cout.flush();
+        _output->finish();
+        std::cout.rdbuf(_output->target());
+        _output.reset();
+    }
+    if (_input) {
+        std::cin.rdbuf(_input->source());
+        _input.reset();
+    }
+}
@@ -0,0 +1,124 @@
+/***************************************************************************************************
+    File: pipeline.h
+
+    Description:
+        Stream buffers that move reading and writing to threads of their own, so that the
+        coder works on one chunk while the next is read and the previous one is written.
+        Installed in std::cin and std::cout, they pipeline any coder that reads and writes
+        through the standard streams: a reader stage, the coder, and a writer stage.
+
+        Each stage hands chunks of CHUNK_SIZE bytes to the next through a single-producer,
+        single-consumer ring, and the chunks go back through a second ring to be reused;
+        PIPELINE_DEPTH chunks are in flight per direction. A thread that finds its ring
+        empty (or full) spins briefly and then sleeps in short steps, which costs nothing
+        next to the time a chunk takes to read, code or write.
+
+        prefetch_buffer reads its source to the end, a chunk ahead of the consumer, so it is
+        only for input that the program reads through. async_buffer writes everything to its
+        target in order; sync hands over what has been written so far without waiting for
+        it, and finish waits until it is all written.
+
+***************************************************************************************************/
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <streambuf>
+#include <thread>
+#include <vector>
+#include "../queue/spscRing.h"
+
+const size_t CHUNK_SIZE = 1 << 20;
+const size_t PIPELINE_DEPTH = 4;
+
+// a chunk handed from one stage to the next: an index into the buffers and its length
+struct pipeline_chunk {
+    size_t buffer;
+    size_t size;
+};
+
+class prefetch_buffer : public std::streambuf {
+    private:
+        std::streambuf *_source;
+        std::vector<std::vector<char>> _buffers;
+        spsc_ring<pipeline_chunk> _full;        // read chunks, reader to consumer
+        spsc_ring<pipeline_chunk> _free;        // used chunks, consumer to reader
+        pipeline_chunk _current;                // the chunk in the get area
+        bool _holding;                          // whether _current must go back
+        bool _ended;                            // the empty chunk that ends the source came
+        std::atomic<bool> _stop;
+        std::thread _reader;
+
+        // body of the reader thread
+        void _read_main();
+
+    protected:
+        int_type underflow() override;
+
+    public:
+        explicit prefetch_buffer(std::streambuf *source);
+        ~prefetch_buffer();
+
+        prefetch_buffer(const prefetch_buffer &) = delete;
+        prefetch_buffer & operator=(const prefetch_buffer &) = delete;
+
+        // the buffer the chunks are read from
+        std::streambuf *source() const { return _source; }
+};
+
+class async_buffer : public std::streambuf {
+    private:
+        std::streambuf *_target;
+        std::vector<std::vector<char>> _buffers;
+        spsc_ring<pipeline_chunk> _full;        // written chunks, producer to writer
+        spsc_ring<pipeline_chunk> _free;        // written out chunks, writer to producer
+        pipeline_chunk _current;                // the chunk in the put area
+        bool _finished;
+        std::thread _writer;
+
+        // body of the writer thread
+        void _write_main();
+
+        // hand the put area to the writer and take a free chunk for the next one
+        void _hand_over();
+
+    protected:
+        int_type overflow(int_type ch) override;
+        std::streamsize xsputn(const char *data, std::streamsize n) override;
+        int sync() override;
+
+    public:
+        explicit async_buffer(std::streambuf *target);
+        ~async_buffer();
+
+        async_buffer(const async_buffer &) = delete;
+        async_buffer & operator=(const async_buffer &) = delete;
+
+        // write out everything and stop the writer
+        void finish();
+
+        // the buffer the chunks are written to
+        std::streambuf *target() const { return _target; }
+};
+
+// puts a prefetch_buffer in std::cin and an async_buffer in std::cout (or either one)
+// for as long as it lives, and the original buffers back when it finishes
+class pipelined_streams {
+    private:
+        std::unique_ptr<prefetch_buffer> _input;
+        std::unique_ptr<async_buffer> _output;
+
+    public:
+        pipelined_streams(bool input, bool output);
+        ~pipelined_streams() { finish(); }
+
+        pipelined_streams(const pipelined_streams &) = delete;
+        pipelined_streams & operator=(const pipelined_streams &) = delete;
+
+        // write out everything written to std::cout and stop both threads
+        void finish();
+};
+
+#endif
@@ -0,0 +1,63 @@
+/***************************************************************************************************
+    File: rangeBuffer.h
+
+    Description:
+        An output stream buffer that passes on only the bytes at positions [start, start +
+        length) of everything written to it, and drops the rest. Installed in std::cout, it
+        cuts a slice out of the output of any decoder; decoders ask it when they may stop.
+
+***************************************************************************************************/
+#ifndef RANGE_BUFFER_H
+#define RANGE_BUFFER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <streambuf>
+
+class range_buffer : public std::streambuf {
+    private:
+        std::streambuf *_target;    // where the bytes in range go
+        uint64_t _position;         // number of bytes written so far
+        uint64_t _start;            // first byte to pass on
+        uint64_t _end;              // one past the last byte to pass on
+
+    protected:
+        std::streamsize xsputn(const char *data, std::streamsize n) override {
+            // pass on the part of [position, position + n) inside the range
+
+            uint64_t from = std::max(_position, _start);
+            uint64_t to = std::min(_position + n, _end);
+            if (from < to) _target->sputn(data + (from - _position), to - from);
+            _position += n;
+            return n;
+        }
+
+        int overflow(int ch) override {
+            // a single character
+
+            if (ch != traits_type::eof()) {
+                char c = static_cast<char>(ch);
+                xsputn(&c, 1);
+            }
+            return ch;
+        }
+
+        int sync() override { return _target->pubsync(); }
+
+    public:
+        range_buffer(std::streambuf *target, uint64_t start, uint64_t length)
+            : _target(target), _position(0), _start(start),
+              _end(length > UINT64_MAX - start ? UINT64_MAX : start + length) {}
+
+        // the buffer the bytes in range go to
+        std::streambuf *target() const { return _target; }
+
+        // count n bytes as written without having them, for output before the range
+        void skip(uint64_t n) { _position += n; }
+
+        // whether the whole range has been passed on, so that the rest of the output
+        // need not be produced at all
+        bool done() const { return _position >= _end; }
+};
+
+#endif
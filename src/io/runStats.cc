@@ -0,0 +1,159 @@
+/***************************************************************************************************
+    File: runStats.cc
+
+    Description:
+        Collecting and writing out the statistics of a run of compress or uncompress.
+
+***************************************************************************************************/
+#include <algorithm>
+#include <cstdio>
+#include "runStats.h"
+#include "../codec/histogram.h"
+
+namespace {
+
+const char *const PHASE_NAMES[PHASE_COUNT] = {"histogram", "tree", "codes", "header", "coding"};
+
+bool known(uint64_t value) {
+    return value != STATS_UNKNOWN;
+}
+
+std::string number(double value, int decimals) {
+    char text[64];
+    std::snprintf(text, sizeof(text), "%.*f", decimals, value);
+    return text;
+}
+
+// the figures both forms report, worked out from what the run collected
+struct derived {
+    double entropy = -1;            // bits per byte, -1 when unknown
+    double achieved = -1;           // coded bits per byte, -1 when unknown
+    double average_length = -1;     // bits per coded byte, -1 when unknown
+    double ratio = -1;              // output over input, -1 when unknown
+
+    explicit derived(const run_stats & stats) {
+        uint64_t original = stats.original_bytes;
+        if (stats.counted && known(original) && original > 0) {
+            entropy = entropy_bits(stats.counts) / original;
+        }
+        if (known(stats.payload_bits) && known(original) && original > 0) {
+            achieved = (double)stats.payload_bits / original;
+        }
+        if (stats.coded_symbols > 0) {
+            average_length = (double)stats.coded_bits / stats.coded_symbols;
+        }
+        if (known(stats.bytes_in) && known(stats.bytes_out) && stats.bytes_in > 0) {
+            ratio = (double)stats.bytes_out / stats.bytes_in;
+        }
+    }
+};
+
+void report_text(const run_stats & stats, std::ostream & out) {
+    derived figures(stats);
+    std::string program = stats.program;
+    out << program << ": " << (stats.format.empty() ? "unknown" : stats.format) << " format\n";
+
+    double total = 0;
+    for (int p = 0; p < PHASE_COUNT; p++) total += stats.seconds[p];
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        if (!stats.timed[p]) continue;
+        out << "  " << PHASE_NAMES[p] << std::string(12 - std::string(PHASE_NAMES[p]).size(), ' ')
+            << number(stats.seconds[p] * 1e3, 3) << " ms";
+        bool pass = p == PHASE_HISTOGRAM || p == PHASE_CODING;
+        if (pass && stats.seconds[p] > 0 && known(stats.original_bytes)) {
+            out << ", " << number(stats.original_bytes / stats.seconds[p] / 1e6, 1) << " MB/s";
+        }
+        out << '\n';
+    }
+    if (total > 0) out << "  total       " << number(total * 1e3, 3) << " ms\n";
+
+    if (known(stats.bytes_in)) out << "  bytes in    " << stats.bytes_in << '\n';
+    if (known(stats.bytes_out)) {
+        out << "  bytes out   " << stats.bytes_out;
+        if (figures.ratio >= 0) out << " (" << number(figures.ratio * 100, 2) << "% of the input)";
+        out << '\n';
+    }
+    if (known(stats.header_bytes)) {
+        out << "  header      " << stats.header_bytes << " bytes";
+        uint64_t compressed = program == "compress" ? stats.bytes_out : stats.bytes_in;
+        if (known(compressed) && compressed > 0) {
+            out << " (" << number(100.0 * stats.header_bytes / compressed, 3) << "%)";
+        }
+        out << '\n';
+    }
+    if (figures.entropy >= 0) {
+        out << "  entropy     " << number(figures.entropy, 4) << " bits per byte\n";
+    }
+    if (figures.achieved >= 0) {
+        out << "  achieved    " << number(figures.achieved, 4) << " bits per byte";
+        if (figures.entropy > 0) {
+            out << " (" << number(100 * (figures.achieved / figures.entropy - 1), 2) << "% over)";
+        }
+        out << '\n';
+    }
+    if (stats.max_code_length > 0) {
+        out << "  codes       longest " << stats.max_code_length << " bits";
+        if (figures.average_length >= 0) {
+            out << ", average " << number(figures.average_length, 4) << " bits";
+        }
+        out << '\n';
+    }
+    for (const auto & note : stats.notes) {
+        int decimals = note.second == (uint64_t)note.second ? 0 : 4;
+        out << "  " << note.first << ' ' << number(note.second, decimals) << '\n';
+    }
+    out.flush();
+}
+
+void report_json(const run_stats & stats, std::ostream & out) {
+    derived figures(stats);
+    out << "{\"program\": \"" << stats.program << "\", \"format\": \"" << stats.format << "\"";
+    out << ", \"seconds\": {";
+    const char *separator = "";
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        if (!stats.timed[p]) continue;
+        out << separator << '"' << PHASE_NAMES[p] << "\": " << number(stats.seconds[p], 6);
+        separator = ", ";
+    }
+    out << '}';
+
+    auto field = [&](const char *name, uint64_t value) {
+        if (known(value)) out << ", \"" << name << "\": " << value;
+    };
+    auto figure = [&](const char *name, double value) {
+        if (value >= 0) out << ", \"" << name << "\": " << number(value, 6);
+    };
+    field("bytes_in", stats.bytes_in);
+    field("bytes_out", stats.bytes_out);
+    field("header_bytes", stats.header_bytes);
+    field("payload_bits", stats.payload_bits);
+    figure("ratio", figures.ratio);
+    figure("entropy_bits_per_byte", figures.entropy);
+    figure("bits_per_byte", figures.achieved);
+    if (stats.max_code_length > 0) field("max_code_length", stats.max_code_length);
+    figure("average_code_length", figures.average_length);
+    for (const auto & note : stats.notes) {
+        out << ", \"" << note.first << "\": "
+            << number(note.second, note.second == (uint64_t)note.second ? 0 : 6);
+    }
+    out << "}" << std::endl;
+}
+
+}
+
+void run_stats::count(const unsigned char *data, size_t size) {
+    count_bytes(data, size, counts);
+    counted = true;
+}
+
+void run_stats::add_code(const unsigned char *lengths, uint64_t bits, uint64_t size) {
+    unsigned longest = *std::max_element(lengths, lengths + 256);
+    max_code_length = std::max(max_code_length, longest);
+    coded_bits += bits;
+    coded_symbols += size;
+}
+
+void report_stats(const run_stats & stats, std::ostream & out) {
+    if (stats.output == STATS_JSON) report_json(stats, out);
+    else report_text(stats, out);
+}
@@ -0,0 +1,109 @@
+/***************************************************************************************************
+    File: runStats.h
+
+    Description:
+        What compress and uncompress report with --stats: how long each phase took, the bytes
+        that went in and out, and how close the code came to the entropy of the input. The
+        programs keep a pointer to a run_stats that is null unless --stats was given, and
+        phase_timer only reads the clock when it is not, so the instrumentation stays in the
+        binaries at the cost of a test per phase. The report goes to standard error, as text
+        or as one JSON object.
+
+***************************************************************************************************/
+#ifndef RUN_STATS_H
+#define RUN_STATS_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// the phases of libhuffman's phase_times, in the same order, which the programs add to
+// the report after each library call; the block format they code themselves on the pool,
+// and time as a whole
+enum stats_phase {
+    PHASE_HISTOGRAM,            // get_char_distribution
+    PHASE_TREE,                 // make_tree, or the code lengths
+    PHASE_CODES,                // make_codes, or the canonical codes
+    PHASE_HEADER,               // writing or reading the tree or the code length table
+    PHASE_CODING,               // write_compress or write_uncompress, or all blocks
+    PHASE_COUNT
+};
+
+enum stats_output {
+    STATS_TEXT,
+    STATS_JSON
+};
+
+// a size or count the run could not tell
+const uint64_t STATS_UNKNOWN = UINT64_MAX;
+
+struct run_stats {
+    const char *program;
+    stats_output output;
+    std::string format;                     // format of the compressed data
+
+    double seconds[PHASE_COUNT] = {};
+    bool timed[PHASE_COUNT] = {};
+
+    uint64_t bytes_in = STATS_UNKNOWN;
+    uint64_t bytes_out = STATS_UNKNOWN;
+    uint64_t original_bytes = STATS_UNKNOWN;    // bytes in for compress, out for uncompress
+    uint64_t header_bytes = STATS_UNKNOWN;      // all of the compressed data but the coded bits
+    uint64_t payload_bits = STATS_UNKNOWN;      // the coded bits, before padding
+
+    // bits and symbols of the coded (not stored or run-length) symbols, and the longest
+    // code, for the code lengths
+    uint64_t coded_bits = 0;
+    uint64_t coded_symbols = 0;
+    unsigned max_code_length = 0;
+
+    // histogram of the original data, for its entropy
+    size_t counts[256] = {};
+    bool counted = false;
+
+    // anything else worth reporting, by name
+    std::vector<std::pair<std::string, double>> notes;
+
+    run_stats(const char *program, stats_output output) : program(program), output(output) {}
+
+    // add the bytes of the original data to the histogram
+    void count(const unsigned char *data, size_t size);
+
+    // add the code lengths of size symbols coded in bits bits
+    void add_code(const unsigned char *lengths, uint64_t bits, uint64_t size);
+
+    void note(const std::string & name, double value) { notes.emplace_back(name, value); }
+};
+
+// times a phase from its construction to its destruction, when stats is not null
+class phase_timer {
+    private:
+        using clock = std::chrono::steady_clock;
+        run_stats *_stats;
+        stats_phase _phase;
+        clock::time_point _start;
+
+    public:
+        phase_timer(run_stats *stats, stats_phase phase) : _stats(stats), _phase(phase) {
+            if (_stats) _start = clock::now();
+        }
+        ~phase_timer() {
+            if (_stats) {
+                std::chrono::duration<double> elapsed = clock::now() - _start;
+                _stats->seconds[_phase] += elapsed.count();
+                _stats->timed[_phase] = true;
+            }
+        }
+
+        phase_timer(const phase_timer &) = delete;
+        phase_timer & operator=(const phase_timer &) = delete;
+};
+
+// write the report of a run in its output form
+void report_stats(const run_stats & stats, std::ostream & out);
+
+#endif
@@ -0,0 +1,863 @@
+/***************************************************************************************************
+    File: huffman.cc
+
+    Description:
+        The buffer API of libhuffman, on top of the codec.
+
+***************************************************************************************************/
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include "huffman.h"
+#include "../codec/block.h"
+#include "../codec/bitWriter.h"
+#include "../codec/blockIndex.h"
+#include "../codec/canonical.h"
+#include "../codec/contextModel.h"
+#include "../codec/decodeTable.h"
+#include "../codec/fileHeader.h"
+#include "../codec/format.h"
+#include "../codec/histogram.h"
+#include "../codec/huffmanTree.h"
+#include "../codec/sharedTable.h"
+#include "../codec/symbolCode.h"
+#include "phaseTimer.h"
+
+namespace huffman {
+
+namespace {
+
+// error codes are the last few values of size_t, far above any real size
+const size_t ERROR_LIMIT = 16;
+
+size_t fail(error code) {
+    return (size_t)0 - (size_t)code;
+}
+
+// inputs from this size up are counted on several threads, when the options allow
+const size_t PARALLEL_HISTOGRAM_SIZE = size_t(16) << 20;
+
+// bytes of input a format with one code codes at a time
+const size_t WHOLE_CHUNK_SIZE = 1 << 20;
+
+bool plausible_size(uint64_t length, size_t coded_size, bool single) {
+    // whether coded_size bytes of bits can hold length symbols: every code of a code
+    // with more than one takes a bit at least, while a single symbol takes none, so
+    // then any length that does not read as an error will do
+
+    if (single) return length <= (size_t)0 - ERROR_LIMIT;
+    return length / 8 <= coded_size;
+}
+
+bool valid(const options & settings) {
+    return settings.format <= OUTPUT_CONTEXT &&
+           settings.block_size >= MIN_BLOCK_SIZE && settings.block_size <= MAX_BLOCK_SIZE &&
+           settings.max_bits <= CANONICAL_MAX_BITS &&
+           settings.streams >= 1 && settings.streams <= MAX_STREAMS &&
+           settings.sync_interval <= MAX_BLOCK_SIZE && settings.min_gain < 100 &&
+           settings.context_groups >= 1 && settings.context_groups <= MAX_CONTEXT_GROUPS;
+}
+
+template <typename F>
+bool for_each_frame(const unsigned char *in, const unsigned char *end, size_t block_size,
+                    F frame) {
+    // walk the frames of the block format from the first one to the end marker,
+    // checking that each fits in the input, and call frame(start, size) on each
+
+    while (true) {
+        if (end - in < 4) return false;
+        size_t size = block_uncompressed_size(in);
+        if (size == 0) return true;
+        if ((size_t)(end - in) < BLOCK_HEADER_SIZE || size > block_size) return false;
+        size_t frame_size = block_frame_size(in);
+        if ((size_t)(end - in) < frame_size || !frame(in, frame_size)) return false;
+        in += frame_size;
+    }
+}
+
+template <typename Encode>
+size_t encode_chunks(size_t size, unsigned max_length, unsigned char *out, size_t capacity,
+                     std::vector<unsigned char> & frame, uint64_t & bits, Encode encode) {
+    // code WHOLE_CHUNK_SIZE bytes at a time with encode(first, n, writer): straight into
+    // out while it has room for the longest codes of a chunk, or else into frame, copied
+    // if they fit. Returns the size of the bits padded to a byte, or an error, and sets
+    // bits to their number before padding.
+
+    bit_writer writer(out);
+    size_t written = 0;
+    bits = 0;
+    for (size_t first = 0; first < size; first += WHOLE_CHUNK_SIZE) {
+        size_t n = std::min(WHOLE_CHUNK_SIZE, size - first);
+        size_t worst = n * max_length / 8 + 16;
+        bool direct = capacity - written >= worst;
+        if (!direct && frame.size() < worst) frame.resize(worst);
+        writer.rebase(direct ? out + written : frame.data());
+        encode(first, n, writer);
+        if (writer.size() > capacity - written) return fail(ERROR_DESTINATION_TOO_SMALL);
+        if (!direct) std::memcpy(out + written, frame.data(), writer.size());
+        written += writer.size();
+        bits += writer.size() * 8;
+    }
+
+    unsigned char tail[8];
+    writer.rebase(tail);
+    bits += writer.bit_count();
+    writer.flush();
+    if (writer.size() > capacity - written) return fail(ERROR_DESTINATION_TOO_SMALL);
+    std::memcpy(out + written, tail, writer.size());
+    return written + writer.size();
+}
+
+// what an encoder keeps between inputs of the formats with one code
+struct whole_encoding {
+    std::vector<size_t> counts;         // the context format's, 256 per context
+    context_code contexts;
+    std::vector<unsigned char> header;
+    std::vector<unsigned char> frame;
+};
+
+size_t encode_context_format(const unsigned char *in, size_t size, unsigned char *out,
+                             size_t capacity, const options & settings, whole_encoding & coding) {
+    // cluster the contexts of the bytes into groups, write the code of every group and
+    // code every byte with the code of its context's group
+
+    phase_timer timer(settings.times, PHASE_HISTOGRAM);
+    coding.counts.assign(256 * 256, 0);
+    count_contexts(in, size, coding.counts.data());
+    context_code & code = coding.contexts;
+    timer.next(PHASE_TREE);     // the codes of the groups are built with their lengths
+    if (!build_context_code(coding.counts.data(), settings.context_groups, settings.max_bits,
+                            code)) {
+        return fail(ERROR_CODE_TOO_LONG);
+    }
+    timer.next(PHASE_HEADER);
+    coding.header.resize(CONTEXT_HEAD_BOUND);
+    size_t head_size = write_context_header(code, size, coding.header.data());
+    if (capacity < head_size) return fail(ERROR_DESTINATION_TOO_SMALL);
+    std::memcpy(out, coding.header.data(), head_size);
+    if (code.single >= 0) return head_size;
+
+    timer.next(PHASE_CODING);
+    uint64_t bits;
+    size_t n = encode_chunks(size, code.max_length, out + head_size, capacity - head_size,
+                             coding.frame, bits,
+                             [&](size_t first, size_t count, bit_writer & writer) {
+        encode_contexts(code, in + first, count, first ? in[first - 1] : 0, writer);
+    });
+    return is_error(n) ? n : head_size + n;
+}
+
+size_t encode_whole(const unsigned char *in, size_t size, unsigned char *out, size_t capacity,
+                    const options & settings, bool sampled, whole_encoding & coding) {
+    // count the bytes (or a sample of them, when sampled), write the header of their
+    // code and then the bits. A code built from a sample must still have a code for
+    // every byte the sample missed.
+
+    if (size == 0) return 0;
+    if (settings.format == OUTPUT_CONTEXT) {
+        return encode_context_format(in, size, out, capacity, settings, coding);
+    }
+    phase_timer timer(settings.times, PHASE_HISTOGRAM);
+    size_t counts[256] = {};
+    if (sampled) {
+        if (count_sample(in, size, settings.sample_size, counts) < size) {
+            for (int k = 0; k < 256; k++) counts[k] = std::max<size_t>(counts[k], 1);
+        }
+    }
+    else if (settings.threads != 1 && size >= PARALLEL_HISTOGRAM_SIZE) {
+        thread_pool pool(settings.threads);
+        count_bytes_parallel(in, size, counts, pool);
+    }
+    else {
+        count_bytes(in, size, counts);
+    }
+
+    unsigned char header[std::max(LEGACY_HEAD_BOUND, CANONICAL_HEAD_BOUND)];
+    uint64_t codes[256];
+    unsigned char lengths[256] = {};
+    size_t head_size;
+    bool legacy = settings.format == OUTPUT_LEGACY;
+    timer.next(PHASE_TREE);
+    if (legacy) {
+        huffman_tree tree;
+        make_tree(counts, tree);
+        timer.next(PHASE_CODES);
+        if (!make_codes(tree, codes, lengths)) return fail(ERROR_CODE_TOO_LONG);
+        timer.next(PHASE_HEADER);
+        head_size = write_legacy_header(tree, size, header);
+    }
+    else {
+        if (!make_code_lengths(counts, lengths, settings.max_bits)) {
+            return fail(ERROR_CODE_TOO_LONG);
+        }
+        timer.next(PHASE_CODES);
+        if (!make_canonical_codes(lengths, codes, 256)) return fail(ERROR_CODE_TOO_LONG);
+        timer.next(PHASE_HEADER);
+        head_size = write_canonical_header(lengths, size, header);
+    }
+    if (capacity < head_size) return fail(ERROR_DESTINATION_TOO_SMALL);
+    std::memcpy(out, header, head_size);
+    timer.next(PHASE_CODING);
+
+    // a tree made of a single leaf, or a table of a single code, stands for its byte
+    // alone, so no bits are written; the original format always ends with a byte of
+    // padding, even after whole bytes
+    unsigned max_length = *std::max_element(lengths, lengths + 256);
+    size_t used = std::count_if(lengths, lengths + 256, [](unsigned char n) { return n > 0; });
+    uint64_t bits = 0;
+    size_t n = 0;
+    if (used > 1) {
+        // a code built from a sample must not take more than a byte a byte, which the
+        // code of the whole input never does: past that, it is built again from all of it
+        size_t room = capacity - head_size;
+        if (sampled) room = std::min(room, size);
+        n = encode_chunks(size, max_length, out + head_size, room,
+                          coding.frame, bits,
+                          [&](size_t first, size_t count, bit_writer & writer) {
+            for (size_t i = first; i < first + count; i++) {
+                writer.put(codes[in[i]], lengths[in[i]]);
+            }
+        });
+        if (is_error(n)) return n;
+    }
+    size_t written = head_size + n;
+    if (legacy && bits % 8 == 0) {
+        if (written == capacity) return fail(ERROR_DESTINATION_TOO_SMALL);
+        out[written++] = 0;
+    }
+    return written;
+}
+
+// what an encoder keeps between symbol arrays of one width
+template <typename Symbol>
+struct symbol_encoding {
+    symbol_counts counts;
+    symbol_code<Symbol> code;
+    symbol_encoder<Symbol> encoder;
+};
+
+// and what a decoder keeps
+template <typename Symbol>
+struct symbol_decoding {
+    symbol_code<Symbol> code;
+    symbol_decoder<Symbol> decoder;
+};
+
+template <typename Symbol>
+size_t encode_symbols(const Symbol *in, size_t count, unsigned char *dst, size_t capacity,
+                      unsigned max_bits, symbol_encoding<Symbol> & coding,
+                      std::vector<unsigned char> & frame, phase_times *times) {
+    // count the symbols, then write the header, the code and the bits straight into
+    // dst; with less room than the worst case, into the frame buffer first
+
+    if (max_bits > CANONICAL_MAX_BITS) return fail(ERROR_PARAMETER);
+    phase_timer timer(times, PHASE_HISTOGRAM);
+    if (!count_symbols(in, count, coding.counts)) return fail(ERROR_SYMBOL);
+    size_t bound = compress_symbols_bound(count);
+    if (capacity < bound) frame.resize(bound);
+    unsigned char *out = capacity < bound ? frame.data() : dst;
+
+    out[0] = FORMAT_MAGIC[0];
+    out[1] = FORMAT_MAGIC[1];
+    out[2] = FORMAT_SYMBOLS;
+    out[3] = sizeof(Symbol);
+    size_t written = SYMBOLS_HEADER_SIZE + store_varint(out + SYMBOLS_HEADER_SIZE, count);
+    if (count > 0) {
+        timer.next(PHASE_TREE);     // the lengths and then the canonical codes
+        if (!build_symbol_code(coding.counts, max_bits, coding.code)) {
+            return fail(ERROR_CODE_TOO_LONG);
+        }
+        timer.next(PHASE_HEADER);
+        written += write_symbol_code(coding.code, out + written);
+    }
+    if (count > 0 && coding.code.symbols.size() > 1) {
+        // the code of a single symbol stands for it alone, with no bits
+        timer.next(PHASE_CODES);
+        coding.encoder.build(coding.code);
+        timer.next(PHASE_CODING);
+        bit_writer writer(out + written);
+        coding.encoder.encode(in, count, writer);
+        writer.flush();
+        written += writer.size();
+    }
+
+    if (out != dst) {
+        if (written > capacity) return fail(ERROR_DESTINATION_TOO_SMALL);
+        std::memcpy(dst, out, written);
+    }
+    return written;
+}
+
+template <typename Symbol>
+size_t read_symbols_header(const unsigned char *in, size_t size, uint64_t & count,
+                           symbol_decoding<Symbol> & coding) {
+    // the header of the symbol format with symbols of Symbol's width, and the decoder of
+    // its code. Returns the size of the header and code, or 0 if they are not valid.
+
+    if (size <= SYMBOLS_HEADER_SIZE || in[3] != sizeof(Symbol)) return 0;
+    size_t n = load_varint(in + SYMBOLS_HEADER_SIZE, in + size, count);
+    if (n == 0 || count > SIZE_MAX / sizeof(Symbol)) return 0;
+    size_t head = SYMBOLS_HEADER_SIZE + n;
+    if (count == 0) return head;
+    size_t table = read_symbol_code(in + head, size - head, coding.code);
+    if (table == 0 || !coding.decoder.build(coding.code)) return 0;
+    return head + table;
+}
+
+template <typename Symbol, typename Place, typename Store>
+size_t decode_symbols(const unsigned char *in, size_t size, size_t capacity,
+                      symbol_decoding<Symbol> & coding, phase_times *times, Place place,
+                      Store store) {
+    // decode a chunk of symbols at a time to where place(first, chunk) says, the
+    // destination itself or the chunk buffer, and pass them to store(first, symbols,
+    // n), checking that the bits do not run past the input
+
+    uint64_t count;
+    phase_timer timer(times, PHASE_HEADER);     // the decoder is built with the code
+    size_t head = read_symbols_header(in, size, count, coding);
+    bool single = count > 0 && coding.code.symbols.size() == 1;
+    if (head == 0 || !plausible_size(count, size - head, single)) return fail(ERROR_CORRUPT);
+    if (count > capacity) return fail(ERROR_DESTINATION_TOO_SMALL);
+    timer.next(PHASE_CODING);
+    bit_reader reader(in + head, size - head);
+    Symbol chunk[1024];
+    for (size_t first = 0; first < count; first += 1024) {
+        size_t n = std::min((size_t)count - first, (size_t)1024);
+        Symbol *symbols = place(first, chunk);
+        if (single) {
+            std::fill(symbols, symbols + n, coding.code.symbols[0]);
+        }
+        else if (!coding.decoder.decode(reader, symbols, n) ||
+                 reader.position() > (size - head) * 8) {
+            return fail(ERROR_CORRUPT);
+        }
+        store(first, symbols, n);
+    }
+    return count;
+}
+
+template <typename Symbol>
+size_t decode_symbol_array(const void *src, size_t size, Symbol *dst, size_t capacity,
+                           symbol_decoding<Symbol> & coding, phase_times *times) {
+    const unsigned char *in = static_cast<const unsigned char *>(src);
+    if (size <= SYMBOLS_HEADER_SIZE || in[0] != FORMAT_MAGIC[0] || in[1] != FORMAT_MAGIC[1] ||
+        in[2] != FORMAT_SYMBOLS || (in[3] != 2 && in[3] != 4)) {
+        return fail(ERROR_CORRUPT);
+    }
+    if (in[3] != sizeof(Symbol)) return fail(ERROR_PARAMETER);
+    return decode_symbols(in, size, capacity, coding, times,
+                          [&](size_t first, Symbol *) { return dst + first; },
+                          [](size_t, const Symbol *, size_t) {});
+}
+
+template <typename Symbol>
+size_t decode_symbol_bytes(const unsigned char *in, size_t size, unsigned char *out,
+                           size_t capacity, symbol_decoding<Symbol> & coding,
+                           phase_times *times) {
+    size_t count = decode_symbols(in, size, capacity / sizeof(Symbol), coding, times,
+                                  [](size_t, Symbol *chunk) { return chunk; },
+                                  [&](size_t first, const Symbol *symbols, size_t n) {
+        unsigned char *p = out + first * sizeof(Symbol);
+        for (size_t i = 0; i < n; i++) {
+            store_le(p + i * sizeof(Symbol), symbols[i], sizeof(Symbol));
+        }
+    });
+    return is_error(count) ? count : count * sizeof(Symbol);
+}
+
+}
+
+bool is_error(size_t result) {
+    return result > (size_t)0 - ERROR_LIMIT;
+}
+
+error get_error(size_t result) {
+    return is_error(result) ? (error)((size_t)0 - result) : ERROR_NONE;
+}
+
+const char *error_message(size_t result) {
+    switch (get_error(result)) {
+        case ERROR_NONE: return "no error";
+        case ERROR_DESTINATION_TOO_SMALL: return "destination buffer is too small";
+        case ERROR_CORRUPT: return "corrupt compressed data";
+        case ERROR_CODE_TOO_LONG: return "the characters do not fit in codes of max_bits bits";
+        case ERROR_PARAMETER: return "option out of range";
+        case ERROR_TABLE: return "the data was compressed with another shared table";
+        case ERROR_SYMBOL: return "a symbol is not below 65536";
+    }
+    return "unknown error";
+}
+
+size_t compress_bound(size_t size, const options & settings) {
+    // a block is coded only when that makes it smaller than storing it, so no
+    // frame is longer than a stored one: the bytes and a header. A code built from
+    // the counts of the whole input takes at most 8 bits a byte, as a fixed-length
+    // code would; then comes the word the bit writer may store past the end, and the
+    // padding byte of the original format.
+
+    if (settings.format == OUTPUT_LEGACY) return LEGACY_HEAD_BOUND + size + 9;
+    if (settings.format == OUTPUT_CANONICAL) return CANONICAL_HEAD_BOUND + size + 8;
+    if (settings.format == OUTPUT_CONTEXT) return CONTEXT_HEAD_BOUND + size + 8;
+    size_t block_size = std::max(settings.block_size, MIN_BLOCK_SIZE);
+    size_t blocks = (size + block_size - 1) / block_size;
+    size_t bound = BLOCKS_HEADER_SIZE + size + 4 + blocks * BLOCK_HEADER_SIZE;
+    if (settings.index) {
+        bound += blocks * BLOCK_INDEX_ENTRY_SIZE + BLOCK_TRAILER_SIZE;
+        if (settings.sync_interval) bound += 4 + size / settings.sync_interval * 4;
+    }
+    return bound;
+}
+
+size_t decompressed_size(const void *src, size_t size) {
+    // read the size from the header, or add up the sizes of the blocks. A header is
+    // only believed when the bits after it can hold that many symbols, so damaged
+    // data is not given a destination of any size it claims.
+
+    const unsigned char *in = static_cast<const unsigned char *>(src);
+    const unsigned char *end = in + size;
+    if (size == 0) return 0;
+    if (in[0] != FORMAT_MAGIC[0] || (size >= 3 && in[1] == FORMAT_MAGIC[1] &&
+                                     in[2] == FORMAT_CANONICAL)) {
+        file_code code;
+        size_t head = read_file_header(in, size, code);
+        bool ok = head != 0 && plausible_size(code.file_size, size - head, code.single >= 0);
+        return ok ? (size_t)code.file_size : fail(ERROR_CORRUPT);
+    }
+    if (size < 3 || in[1] != FORMAT_MAGIC[1]) return fail(ERROR_CORRUPT);
+    if (in[2] == FORMAT_TABLE) {
+        uint64_t file_size;
+        size_t n = size > TABLE_HEADER_SIZE ? load_varint(in + TABLE_HEADER_SIZE, end, file_size)
+                                            : 0;
+        bool ok = n != 0 && plausible_size(file_size, size - TABLE_HEADER_SIZE - n, false);
+        return ok ? (size_t)file_size : fail(ERROR_CORRUPT);
+    }
+    if (in[2] == FORMAT_CONTEXT) {
+        context_code code;
+        uint64_t length;
+        size_t head = read_context_header(in, size, code, length);
+        bool ok = head != 0 && plausible_size(length, size - head, code.single >= 0);
+        return ok ? (size_t)length : fail(ERROR_CORRUPT);
+    }
+    if (in[2] == FORMAT_SYMBOLS) {
+        size_t count = decompressed_symbols(src, size);
+        return is_error(count) ? count : count * in[3];
+    }
+    if (in[2] != FORMAT_BLOCKS || size < BLOCKS_HEADER_SIZE) return fail(ERROR_CORRUPT);
+
+    size_t total = 0;
+    bool ok = for_each_frame(in + BLOCKS_HEADER_SIZE, end, load_le(in + 4, 4),
+                             [&](const unsigned char *frame, size_t) {
+        total += block_uncompressed_size(frame);
+        return true;
+    });
+    return ok ? total : fail(ERROR_CORRUPT);
+}
+
+size_t compress_symbols_bound(size_t count) {
+    // a Huffman code is never longer on average than a fixed-length code of the
+    // symbols used, which takes at most 16 bits a symbol; and the word the bit
+    // writer may store past the end
+
+    size_t used = std::min(count, MAX_ALPHABET_SIZE);
+    return SYMBOLS_HEADER_SIZE + VARINT_BOUND + symbol_code_bound(used) + count * 2 + 8;
+}
+
+size_t decompressed_symbols(const void *src, size_t size) {
+    // the count of the header, when the bits after the code can hold that many symbols;
+    // the code table is the same for either width
+
+    const unsigned char *in = static_cast<const unsigned char *>(src);
+    uint64_t count;
+    size_t n;
+    if (size <= SYMBOLS_HEADER_SIZE || in[0] != FORMAT_MAGIC[0] || in[1] != FORMAT_MAGIC[1] ||
+        in[2] != FORMAT_SYMBOLS || (in[3] != 2 && in[3] != 4) ||
+        (n = load_varint(in + SYMBOLS_HEADER_SIZE, in + size, count)) == 0 ||
+        count > ((size_t)0 - ERROR_LIMIT) / in[3]) {
+        return fail(ERROR_CORRUPT);
+    }
+    if (count == 0) return 0;
+    size_t head = SYMBOLS_HEADER_SIZE + n;
+    symbol_code<uint32_t> code;
+    size_t table = read_symbol_code(in + head, size - head, code);
+    if (table == 0 || !plausible_size(count, size - head - table, code.symbols.size() == 1)) {
+        return fail(ERROR_CORRUPT);
+    }
+    return count;
+}
+
+static_assert(huffman::MAX_SYMBOLS == MAX_ALPHABET_SIZE, "symbol alphabets differ");
+static_assert(huffman::TABLE_FILE_BOUND == ::TABLE_FILE_BOUND, "table file sizes differ");
+
+// the samples of a table in training, and once it is ready its code and decoder
+struct shared_table::state {
+    size_t counts[256] = {};
+    bool ready = false;
+    shared_code code;
+    decode_table table;
+
+    size_t finish() {
+        // build the decoder of a new code once, for every decoder to share
+
+        ready = table.build(code.codes, code.lengths, 256);
+        return ready ? 0 : fail(ERROR_CORRUPT);
+    }
+};
+
+shared_table::shared_table() : _state(new state) {}
+
+shared_table::~shared_table() {}
+
+void shared_table::add_sample(const void *src, size_t size) {
+    count_bytes(static_cast<const unsigned char *>(src), size, _state->counts);
+}
+
+size_t shared_table::train(unsigned max_bits) {
+    if ((max_bits != 0 && max_bits < 8) || max_bits > CANONICAL_MAX_BITS) {
+        return fail(ERROR_PARAMETER);
+    }
+    if (!train_shared_code(_state->counts, max_bits, _state->code)) {
+        return fail(ERROR_CODE_TOO_LONG);
+    }
+    return _state->finish();
+}
+
+size_t shared_table::load(const void *src, size_t size) {
+    size_t n = read_table_file(static_cast<const unsigned char *>(src), size, _state->code);
+    if (n == 0) return fail(ERROR_CORRUPT);
+    size_t result = _state->finish();
+    return is_error(result) ? result : n;
+}
+
+size_t shared_table::save(void *dst, size_t capacity) const {
+    unsigned char file[::TABLE_FILE_BOUND];
+    if (!_state->ready) return fail(ERROR_PARAMETER);
+    size_t n = write_table_file(_state->code, file);
+    if (n > capacity) return fail(ERROR_DESTINATION_TOO_SMALL);
+    std::memcpy(dst, file, n);
+    return n;
+}
+
+bool shared_table::ready() const {
+    return _state->ready;
+}
+
+uint32_t shared_table::id() const {
+    return _state->ready ? _state->code.id : 0;
+}
+
+size_t compress_bound(size_t size, const shared_table & table) {
+    // the header, every byte at the longest code, and the word the bit writer
+    // may store past the end
+
+    unsigned max_length = table._state->ready ? table._state->code.max_length : 8;
+    return TABLE_HEADER_SIZE + VARINT_BOUND + (size / 8 + 1) * max_length + 8;
+}
+
+// the encoder keeps the frame of the last block, its sync points and the index, the
+// scratch memory of the formats with one code and that of each symbol width
+struct encoder::state {
+    options settings;
+    std::vector<unsigned char> frame;
+    std::vector<uint32_t> sync;
+    block_index index;
+    std::vector<unsigned char> trailer;
+    whole_encoding whole;
+    symbol_encoding<uint16_t> narrow;
+    symbol_encoding<uint32_t> wide;
+};
+
+encoder::encoder(const options & settings) : _state(new state) {
+    _state->settings = settings;
+}
+
+encoder::~encoder() {}
+
+const options & encoder::settings() const {
+    return _state->settings;
+}
+
+size_t encoder::compress(const void *src, size_t size, void *dst, size_t capacity) {
+    // the formats with one code in one go; otherwise the same layout compress_blocks
+    // writes: header, frames, end marker and index
+
+    const unsigned char *in = static_cast<const unsigned char *>(src);
+    unsigned char *out = static_cast<unsigned char *>(dst);
+    state & s = *_state;
+    const options & settings = s.settings;
+    if (!valid(settings)) return fail(ERROR_PARAMETER);
+    if (settings.format != OUTPUT_BLOCKS) {
+        // a code built from a sample that codes the input worse than a byte a byte, or
+        // does not fit where a code of all of it would, is built again from all of it
+        bool sampled = settings.sample_size && settings.format != OUTPUT_CONTEXT &&
+                       settings.sample_size < size;
+        size_t n = encode_whole(in, size, out, capacity, settings, sampled, s.whole);
+        if (sampled && get_error(n) == ERROR_DESTINATION_TOO_SMALL) {
+            n = encode_whole(in, size, out, capacity, settings, false, s.whole);
+        }
+        return n;
+    }
+    if (capacity < BLOCKS_HEADER_SIZE + 4) return fail(ERROR_DESTINATION_TOO_SMALL);
+
+    bool sync = settings.index && settings.sync_interval;
+    out[0] = FORMAT_MAGIC[0];
+    out[1] = FORMAT_MAGIC[1];
+    out[2] = FORMAT_BLOCKS;
+    out[3] = (settings.index ? BLOCKS_FLAG_INDEX : 0) | (sync ? BLOCKS_FLAG_SYNC : 0);
+    store_le(out + 4, settings.block_size, 4);
+    size_t written = BLOCKS_HEADER_SIZE;
+
+    phase_timer timer(settings.times, PHASE_CODING);     // every phase of every block
+    s.index.blocks.clear();
+    s.index.sync.clear();
+    s.index.sync_interval = sync ? settings.sync_interval : 0;
+    for (size_t start = 0; start < size; start += settings.block_size) {
+        size_t n = std::min(settings.block_size, size - start);
+        s.sync.clear();
+        if (!encode_block(in + start, n, settings.max_bits, settings.streams, settings.min_gain,
+                          s.frame, s.index.sync_interval, &s.sync)) {
+            return fail(ERROR_CODE_TOO_LONG);
+        }
+        if (capacity - written < s.frame.size()) return fail(ERROR_DESTINATION_TOO_SMALL);
+        std::memcpy(out + written, s.frame.data(), s.frame.size());
+        s.index.blocks.push_back({written, load_le(s.frame.data() + 4, 4), n, s.index.sync.size()});
+        s.index.sync.insert(s.index.sync.end(), s.sync.begin(), s.sync.end());
+        written += s.frame.size();
+    }
+
+    s.trailer.assign(4, 0);
+    if (settings.index) write_block_index(s.index, written + 4, s.trailer);
+    if (capacity - written < s.trailer.size()) return fail(ERROR_DESTINATION_TOO_SMALL);
+    std::memcpy(out + written, s.trailer.data(), s.trailer.size());
+    return written + s.trailer.size();
+}
+
+size_t encoder::compress(const shared_table & table, const void *src, size_t size, void *dst,
+                         size_t capacity) {
+    // the header names the table, and the bytes are coded straight away; with less
+    // room than the worst case, they are coded into the frame buffer first
+
+    const unsigned char *in = static_cast<const unsigned char *>(src);
+    if (!table.ready()) return fail(ERROR_PARAMETER);
+    const shared_code & code = table._state->code;
+    size_t bound = compress_bound(size, table);
+    std::vector<unsigned char> & frame = _state->frame;
+    if (capacity < bound) frame.resize(bound);
+    unsigned char *out = capacity < bound ? frame.data() : static_cast<unsigned char *>(dst);
+
+    out[0] = FORMAT_MAGIC[0];
+    out[1] = FORMAT_MAGIC[1];
+    out[2] = FORMAT_TABLE;
+    store_le(out + 3, code.id, 4);
+    size_t head_size = TABLE_HEADER_SIZE + store_varint(out + TABLE_HEADER_SIZE, size);
+    phase_timer timer(_state->settings.times, PHASE_CODING);
+    bit_writer writer(out + head_size);
+    for (size_t i = 0; i < size; i++) writer.put(code.codes[in[i]], code.lengths[in[i]]);
+    writer.flush();
+
+    size_t written = head_size + writer.size();
+    if (out != dst) {
+        if (written > capacity) return fail(ERROR_DESTINATION_TOO_SMALL);
+        std::memcpy(dst, out, written);
+    }
+    return written;
+}
+
+size_t encoder::compress_symbols(const uint16_t *src, size_t count, void *dst, size_t capacity,
+                                 unsigned max_bits) {
+    return encode_symbols(src, count, static_cast<unsigned char *>(dst), capacity, max_bits,
+                          _state->narrow, _state->frame, _state->settings.times);
+}
+
+size_t encoder::compress_symbols(const uint32_t *src, size_t count, void *dst, size_t capacity,
+                                 unsigned max_bits) {
+    return encode_symbols(src, count, static_cast<unsigned char *>(dst), capacity, max_bits,
+                          _state->wide, _state->frame, _state->settings.times);
+}
+
+// the decoder keeps the tables of the last block or file it decoded, the code of
+// the last file of the original or canonical format, the tables of every group of
+// the context format and those of the last symbol array of each width
+struct decoder::state {
+    phase_times *times;
+    decode_table table;
+    file_code code;
+    context_code context;
+    context_decoder contexts;
+    symbol_decoding<uint16_t> narrow;
+    symbol_decoding<uint32_t> wide;
+};
+
+decoder::decoder(phase_times *times) : _state(new state) {
+    _state->times = times;
+}
+
+decoder::~decoder() {}
+
+size_t decoder::decompress(const void *src, size_t size, void *dst, size_t capacity) {
+    // tell the format apart the way uncompress does, then decode it in one go
+
+    const unsigned char *in = static_cast<const unsigned char *>(src);
+    const unsigned char *end = in + size;
+    unsigned char *out = static_cast<unsigned char *>(dst);
+    decode_table & table = _state->table;
+    if (size == 0) return 0;
+
+    file_code & code = _state->code;
+    if (in[0] != FORMAT_MAGIC[0] || (size >= 3 && in[1] == FORMAT_MAGIC[1] &&
+                                     in[2] == FORMAT_CANONICAL)) {
+        // the original and canonical formats: a header, then one stream of bits
+        phase_timer timer(_state->times, PHASE_HEADER);     // the codes come with it
+        size_t head = read_file_header(in, size, code);
+        if (head == 0 || !plausible_size(code.file_size, size - head, code.single >= 0)) {
+            return fail(ERROR_CORRUPT);
+        }
+        if (code.file_size > capacity) return fail(ERROR_DESTINATION_TOO_SMALL);
+        if (code.single >= 0) {
+            timer.next(PHASE_CODING);
+            std::memset(out, code.single, code.file_size);
+            return code.file_size;
+        }
+        if (code.file_size == 0) return 0;
+        timer.next(PHASE_CODES);
+        if (!table.build(code.codes, code.lengths, 256)) return fail(ERROR_CORRUPT);
+        timer.next(PHASE_CODING);
+        in += head;
+        bit_reader reader(in, end - in);
+        if (!table.decode(reader, out, code.file_size) ||
+            reader.position() > (size_t)(end - in) * 8) {
+            return fail(ERROR_CORRUPT);
+        }
+        return code.file_size;
+    }
+    if (size >= BLOCKS_HEADER_SIZE && in[1] == FORMAT_MAGIC[1] && in[2] == FORMAT_BLOCKS) {
+        // frames, each decoded straight into the destination
+        phase_timer timer(_state->times, PHASE_CODING);
+        size_t written = 0;
+        bool too_small = false;
+        bool ok = for_each_frame(in + BLOCKS_HEADER_SIZE, end, load_le(in + 4, 4),
+                                 [&](const unsigned char *frame, size_t frame_size) {
+            size_t n = block_uncompressed_size(frame);
+            if (n > capacity - written) {
+                too_small = true;
+                return false;
+            }
+            if (!decode_block(frame, frame_size, out + written, table)) return false;
+            written += n;
+            return true;
+        });
+        if (too_small) return fail(ERROR_DESTINATION_TOO_SMALL);
+        return ok ? written : fail(ERROR_CORRUPT);
+    }
+    if (size >= 3 && in[1] == FORMAT_MAGIC[1] && in[2] == FORMAT_TABLE) {
+        return fail(ERROR_TABLE);
+    }
+    if (size >= 3 && in[1] == FORMAT_MAGIC[1] && in[2] == FORMAT_CONTEXT) {
+        // the codes of every group, switched by the previous byte
+        uint64_t length;
+        phase_timer timer(_state->times, PHASE_HEADER);
+        size_t head = read_context_header(in, size, _state->context, length);
+        if (head == 0 || !plausible_size(length, size - head, _state->context.single >= 0)) {
+            return fail(ERROR_CORRUPT);
+        }
+        timer.next(PHASE_CODES);
+        if (!_state->contexts.build(_state->context)) return fail(ERROR_CORRUPT);
+        if (length > capacity) return fail(ERROR_DESTINATION_TOO_SMALL);
+        timer.next(PHASE_CODING);
+        if (_state->context.single >= 0) {
+            std::memset(out, _state->context.single, length);
+            return length;
+        }
+        in += head;
+        unsigned char previous = 0;
+        bit_reader reader(in, end - in);
+        if (!_state->contexts.decode(reader, out, length, previous) ||
+            reader.position() > (size_t)(end - in) * 8) {
+            return fail(ERROR_CORRUPT);
+        }
+        return length;
+    }
+    if (size > SYMBOLS_HEADER_SIZE && in[1] == FORMAT_MAGIC[1] && in[2] == FORMAT_SYMBOLS) {
+        // the symbols of either width, each written little-endian
+        if (in[3] == 2) {
+            return decode_symbol_bytes(in, size, out, capacity, _state->narrow, _state->times);
+        }
+        if (in[3] == 4) {
+            return decode_symbol_bytes(in, size, out, capacity, _state->wide, _state->times);
+        }
+        return fail(ERROR_CORRUPT);
+    }
+    return fail(ERROR_CORRUPT);
+}
+
+size_t decoder::decompress(const shared_table & table, const void *src, size_t size, void *dst,
+                           size_t capacity) {
+    // data of the table's format is decoded with the table's own decoder, which
+    // is built already; anything else as without a table
+
+    const unsigned char *in = static_cast<const unsigned char *>(src);
+    const unsigned char *end = in + size;
+    if (size < 3 || in[0] != FORMAT_MAGIC[0] || in[1] != FORMAT_MAGIC[1] || in[2] != FORMAT_TABLE) {
+        return decompress(src, size, dst, capacity);
+    }
+    uint64_t file_size;
+    size_t n = size > TABLE_HEADER_SIZE ? load_varint(in + TABLE_HEADER_SIZE, end, file_size) : 0;
+    if (n == 0 || !plausible_size(file_size, size - TABLE_HEADER_SIZE - n, false)) {
+        return fail(ERROR_CORRUPT);
+    }
+    if (!table.ready() || load_le(in + 3, 4) != table.id()) return fail(ERROR_TABLE);
+    if (file_size > capacity) return fail(ERROR_DESTINATION_TOO_SMALL);
+
+    phase_timer timer(_state->times, PHASE_CODING);
+    in += TABLE_HEADER_SIZE + n;
+    bit_reader reader(in, end - in);
+    if (!table._state->table.decode(reader, static_cast<unsigned char *>(dst), file_size) ||
+        reader.position() > (size_t)(end - in) * 8) {
+        return fail(ERROR_CORRUPT);
+    }
+    return file_size;
+}
+
+size_t decoder::decompress_symbols(const void *src, size_t size, uint16_t *dst,
+                                   size_t capacity) {
+    return decode_symbol_array(src, size, dst, capacity, _state->narrow, _state->times);
+}
+
+size_t decoder::decompress_symbols(const void *src, size_t size, uint32_t *dst,
+                                   size_t capacity) {
+    return decode_symbol_array(src, size, dst, capacity, _state->wide, _state->times);
+}
+
+size_t compress(const void *src, size_t size, void *dst, size_t capacity,
+                const options & settings) {
+    encoder context(settings);
+    return context.compress(src, size, dst, capacity);
+}
+
+size_t decompress(const void *src, size_t size, void *dst, size_t capacity) {
+    decoder context;
+    return context.decompress(src, size, dst, capacity);
+}
+
+size_t compress_symbols(const uint16_t *src, size_t count, void *dst, size_t capacity,
+                        unsigned max_bits) {
+    encoder context;
+    return context.compress_symbols(src, count, dst, capacity, max_bits);
+}
+
+size_t compress_symbols(const uint32_t *src, size_t count, void *dst, size_t capacity,
+                        unsigned max_bits) {
+    encoder context;
+    return context.compress_symbols(src, count, dst, capacity, max_bits);
+}
+
+size_t decompress_symbols(const void *src, size_t size, uint16_t *dst, size_t capacity) {
+    decoder context;
+    return context.decompress_symbols(src, size, dst, capacity);
+}
+
+size_t decompress_symbols(const void *src, size_t size, uint32_t *dst, size_t capacity) {
+    decoder context;
+    return context.decompress_symbols(src, size, dst, capacity);
+}
+
+}
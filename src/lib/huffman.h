@@ -0,0 +1,338 @@
+/***************************************************************************************************
+    File: huffman.h
+
+    Description:
+        libhuffman: Huffman compression of memory buffers, for programs that want to compress
+        without running the compress and uncompress programs. compress writes the block format
+        of compress -B (see codec/format.h), so its output can be read by uncompress and the
+        other way round; decompress reads every format the programs write.
+
+        The formats with one code for the whole input (options::format) count all of it
+        before coding any of it, so they take the input in one buffer, and a stream_encoder
+        always writes the block format.
+
+        Nothing here reads or writes files or streams, and buffers are always provided by the
+        caller. An encoder or decoder keeps the scratch memory of its last call, so a service
+        that keeps one per thread does not allocate once it has seen its largest payload. The
+        free functions create a context for every call.
+
+        Functions that produce bytes return how many they wrote, or an error code that
+        is_error recognizes:
+
+            size_t n = huffman::compress(src, size, dst, huffman::compress_bound(size));
+            if (huffman::is_error(n)) std::cerr << huffman::error_message(n) << std::endl;
+
+        Data that arrives in pieces goes through a stream_encoder or stream_decoder instead:
+        feed hands over input and returns how much of it was taken, drain fills output space
+        and returns how much it wrote, and finish tells that no more input will come. Partial
+        codes stay in the context between calls, so pieces may be cut anywhere. A stream
+        encoder holds the input of one block, about 3K plus up to block_size bytes: its
+        buffer grows with the input it is fed, so a short stream takes little more than it
+        is fed, and a long one the whole block size. Unless it is given options, a stream
+        encoder codes blocks of STREAM_BLOCK_SIZE (16K), so tens of thousands of open
+        streams fit in a few hundred MB, for about 1% more output than the 1M blocks of
+        compress -B on text. A stream decoder holds
+        STREAM_BUFFER_SIZE bytes of input (or the buffer size it was given) and the tables
+        of one block, whatever the block size. It reads the formats the stream encoder and
+        the encoder write, but not those of the shared table or of symbol arrays.
+
+            while (have input) {
+                size_t taken = encoder.feed(piece, size);
+                piece += taken, size -= taken;
+                send(out, encoder.drain(out, sizeof(out)));
+            }
+            encoder.finish();
+            while (!encoder.done()) send(out, encoder.drain(out, sizeof(out)));
+
+        Many small payloads of the same kind compress better with a shared_table: trained
+        once on samples of them (or loaded from a file written by compress --train), it
+        spares each payload its own code table and the pass that counts its bytes.
+        Payloads compressed with a table decompress only with the same table.
+
+        Arrays of 16-bit or 32-bit symbols, such as audio samples or token IDs below
+        MAX_SYMBOLS, compress better with compress_symbols, which codes the symbols rather
+        than their bytes. decompress_symbols gives them back as an array of the same width;
+        decompress gives their bytes, little-endian.
+
+***************************************************************************************************/
+#ifndef LIBHUFFMAN_H
+#define LIBHUFFMAN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace huffman {
+
+enum error {
+    ERROR_NONE = 0,
+    ERROR_DESTINATION_TOO_SMALL,    // the output does not fit in the destination buffer
+    ERROR_CORRUPT,                  // the input is not compressed data, or is damaged
+    ERROR_CODE_TOO_LONG,            // the symbols do not fit in codes of max_bits bits
+    ERROR_PARAMETER,                // an option is out of range
+    ERROR_TABLE,                    // the data needs a shared table other than the one given
+    ERROR_SYMBOL                    // a symbol of an array is not below MAX_SYMBOLS
+};
+
+// what encoder::compress writes (see codec/format.h)
+enum output_format {
+    OUTPUT_BLOCKS,                  // independently coded blocks, as compress -B writes
+    OUTPUT_CANONICAL,               // one code for the whole input, as compress -c writes
+    OUTPUT_LEGACY,                  // one code stored as a tree, as compress writes
+    OUTPUT_CONTEXT                  // codes chosen by the previous byte, as compress -1 writes
+};
+
+// the phases of coding that encoders and decoders time when given a phase_times
+enum phase {
+    PHASE_HISTOGRAM,                // counting the symbols
+    PHASE_TREE,                     // the tree or the code lengths
+    PHASE_CODES,                    // the codes, or the tables that decode them
+    PHASE_HEADER,                   // writing or reading the header
+    PHASE_CODING,                   // coding or decoding the symbols, or all the blocks
+    PHASE_COUNT
+};
+
+// seconds spent in each phase, added to by every call made with it
+struct phase_times {
+    double seconds[PHASE_COUNT] = {};
+    bool timed[PHASE_COUNT] = {};
+};
+
+// how encoders compress; the defaults are those of compress -B
+struct options {
+    output_format format = OUTPUT_BLOCKS;
+    size_t block_size = 1 << 20;    // bytes per block, from 4K to 16M
+    unsigned max_bits = 0;          // limit on code lengths (1-63), 0 for none; not for
+                                    // OUTPUT_LEGACY, whose tree is never limited
+    unsigned streams = 4;           // streams per block decoded side by side (1-16)
+    bool index = true;              // end with a block index, for random access
+    size_t sync_interval = 0;       // bytes between sync points in the index, 0 for none
+    unsigned min_gain = 1;          // percent a block must shrink by to be coded (0-99),
+                                    // or it is stored as it is
+    size_t sample_size = 0;         // build the code of OUTPUT_CANONICAL or OUTPUT_LEGACY
+                                    // from this many bytes spread over the input, 0 for all
+    unsigned context_groups = 16;   // codes of OUTPUT_CONTEXT shared by the contexts (1-64)
+    unsigned threads = 1;           // threads that count a large input of a format with
+                                    // one code, 0 for all cores
+    phase_times *times = nullptr;   // where encoder::compress and compress_symbols add the
+                                    // time of each phase, or nowhere; the clock is read
+                                    // only when it is set
+};
+
+// whether a returned size is an error code, and which one
+bool is_error(size_t result);
+error get_error(size_t result);
+const char *error_message(size_t result);
+
+// the largest number of bytes compress can write for size bytes of input
+size_t compress_bound(size_t size, const options & settings = options());
+
+// the number of bytes the compressed data in [src, src + size) decompresses to, or an error;
+// ERROR_CORRUPT when the header claims more than the data after it can hold
+size_t decompressed_size(const void *src, size_t size);
+
+// the largest number of bytes compress_symbols can write for count symbols
+size_t compress_symbols_bound(size_t count);
+
+// the number of symbols the symbol format data in [src, src + size) decompresses to, or an
+// error, checked the same way
+size_t decompressed_symbols(const void *src, size_t size);
+
+// symbols compress_symbols takes are below this
+const size_t MAX_SYMBOLS = 1 << 16;
+
+// largest table file shared_table::save writes
+const size_t TABLE_FILE_BOUND = 266;
+
+// a code shared by many payloads. Once trained or loaded it does not change, so any
+// number of encoders and decoders on any threads may use it at once.
+class shared_table {
+    private:
+        struct state;
+        std::unique_ptr<state> _state;
+
+        friend class encoder;
+        friend class decoder;
+        friend size_t compress_bound(size_t size, const shared_table & table);
+
+    public:
+        shared_table();
+        ~shared_table();
+
+        shared_table(const shared_table &) = delete;
+        shared_table & operator=(const shared_table &) = delete;
+
+        // add the bytes of a sample to the histogram the table is trained on
+        void add_sample(const void *src, size_t size);
+
+        // build the code from the samples added so far, with codes of at most max_bits
+        // bits (8-63, 0 for 15). Every byte value gets a code, sampled or not. Returns 0
+        // or an error.
+        size_t train(unsigned max_bits = 0);
+
+        // read a table file from the size bytes at src. Returns how many bytes it took,
+        // or an error.
+        size_t load(const void *src, size_t size);
+
+        // write the table file of a trained or loaded table to dst. Returns its size (at
+        // most TABLE_FILE_BOUND) or an error.
+        size_t save(void *dst, size_t capacity) const;
+
+        // whether the table has a code, and the ID that names it in compressed data
+        bool ready() const;
+        uint32_t id() const;
+};
+
+// the largest number of bytes encoder::compress can write for size bytes with table
+size_t compress_bound(size_t size, const shared_table & table);
+
+class encoder {
+    private:
+        struct state;
+        std::unique_ptr<state> _state;
+
+    public:
+        explicit encoder(const options & settings = options());
+        ~encoder();
+
+        encoder(const encoder &) = delete;
+        encoder & operator=(const encoder &) = delete;
+
+        const options & settings() const;
+
+        // compress size bytes at src into at most capacity bytes at dst. Returns the
+        // compressed size or an error; capacity of compress_bound(size) is always enough.
+        size_t compress(const void *src, size_t size, void *dst, size_t capacity);
+
+        // same, with the codes of a shared table instead of a code of its own, in a
+        // single pass. The other settings do not apply.
+        size_t compress(const shared_table & table, const void *src, size_t size, void *dst,
+                        size_t capacity);
+
+        // compress count symbols at src, each below MAX_SYMBOLS (ERROR_SYMBOL otherwise,
+        // whatever their width), with one code over the symbols limited to max_bits bits
+        // (1-63, 0 for none). Returns the compressed size or an error; capacity of
+        // compress_symbols_bound(count) is always enough.
+        size_t compress_symbols(const uint16_t *src, size_t count, void *dst, size_t capacity,
+                                unsigned max_bits = 0);
+        size_t compress_symbols(const uint32_t *src, size_t count, void *dst, size_t capacity,
+                                unsigned max_bits = 0);
+};
+
+class decoder {
+    private:
+        struct state;
+        std::unique_ptr<state> _state;
+
+    public:
+        // adds the time of each phase to times, when it is not null
+        explicit decoder(phase_times *times = nullptr);
+        ~decoder();
+
+        decoder(const decoder &) = delete;
+        decoder & operator=(const decoder &) = delete;
+
+        // decompress the size bytes at src into at most capacity bytes at dst. Returns
+        // the decompressed size or an error.
+        size_t decompress(const void *src, size_t size, void *dst, size_t capacity);
+
+        // same, for data that may have been compressed with table
+        size_t decompress(const shared_table & table, const void *src, size_t size, void *dst,
+                          size_t capacity);
+
+        // decompress symbols compressed with compress_symbols into at most capacity symbols
+        // at dst, which must have the width they were compressed from. Returns the number
+        // of symbols or an error.
+        size_t decompress_symbols(const void *src, size_t size, uint16_t *dst, size_t capacity);
+        size_t decompress_symbols(const void *src, size_t size, uint32_t *dst, size_t capacity);
+};
+
+// bytes of compressed input a stream_decoder keeps
+const size_t STREAM_BUFFER_SIZE = 4 << 10;
+
+// block size of a stream_encoder made without options
+const size_t STREAM_BLOCK_SIZE = 16 << 10;
+
+class stream_encoder {
+    private:
+        struct state;
+        std::unique_ptr<state> _state;
+
+    public:
+        // writes the block format without a block index, whatever settings.index says;
+        // without settings, the defaults with blocks of STREAM_BLOCK_SIZE
+        stream_encoder();
+        explicit stream_encoder(const options & settings);
+        ~stream_encoder();
+
+        stream_encoder(const stream_encoder &) = delete;
+        stream_encoder & operator=(const stream_encoder &) = delete;
+
+        // take up to size bytes of input. Returns how many were taken: fewer than size
+        // once a whole block is waiting to be drained, and none after finish.
+        size_t feed(const void *src, size_t size);
+
+        // write up to capacity bytes of compressed output to dst. Returns how many were
+        // written (0 when the encoder needs more input) or an error.
+        size_t drain(void *dst, size_t capacity);
+
+        // no more input: the last block and the end marker are drained next
+        void finish();
+
+        // whether everything has been drained after finish
+        bool done() const;
+
+        // start a new stream with the same settings
+        void reset();
+};
+
+class stream_decoder {
+    private:
+        struct state;
+        std::unique_ptr<state> _state;
+
+    public:
+        // keeps buffer_size bytes of compressed input (at least STREAM_BUFFER_SIZE), or
+        // more while it reads a header larger than that, and adds the time of each phase
+        // to times when it is not null
+        explicit stream_decoder(size_t buffer_size = STREAM_BUFFER_SIZE,
+                                phase_times *times = nullptr);
+        ~stream_decoder();
+
+        stream_decoder(const stream_decoder &) = delete;
+        stream_decoder & operator=(const stream_decoder &) = delete;
+
+        // take up to size bytes of compressed input. Returns how many were taken, which
+        // is fewer than size when the input buffer is full and output must be drained.
+        size_t feed(const void *src, size_t size);
+
+        // decode up to capacity bytes into dst. Returns how many were written (0 when the
+        // decoder needs more input) or an error.
+        size_t drain(void *dst, size_t capacity);
+
+        // no more input: drain reports corrupt data if the compressed data stops short
+        void finish();
+
+        // whether the whole original data has been drained
+        bool done() const;
+
+        // start decoding a new stream
+        void reset();
+};
+
+// one-shot versions of encoder::compress and decoder::decompress
+size_t compress(const void *src, size_t size, void *dst, size_t capacity,
+                const options & settings = options());
+size_t decompress(const void *src, size_t size, void *dst, size_t capacity);
+
+// one-shot versions of encoder::compress_symbols and decoder::decompress_symbols
+size_t compress_symbols(const uint16_t *src, size_t count, void *dst, size_t capacity,
+                        unsigned max_bits = 0);
+size_t compress_symbols(const uint32_t *src, size_t count, void *dst, size_t capacity,
+                        unsigned max_bits = 0);
+size_t decompress_symbols(const void *src, size_t size, uint16_t *dst, size_t capacity);
+size_t decompress_symbols(const void *src, size_t size, uint32_t *dst, size_t capacity);
+
+}
+
+#endif
@@ -0,0 +1,54 @@
+/***************************************************************************************************
+    File: phaseTimer.h
+
+    Description:
+        How the encoders and decoders of libhuffman time their phases into the phase_times
+        a caller gave them. Without one, a phase costs a test of a null pointer.
+
+***************************************************************************************************/
+#ifndef LIBHUFFMAN_PHASE_TIMER_H
+#define LIBHUFFMAN_PHASE_TIMER_H
+
+#include <chrono>
+#include "huffman.h"
+
+namespace huffman {
+
+// times a phase from its construction, and each phase next starts from the end of the one
+// before, until its destruction; when times is not null
+class phase_timer {
+    private:
+        using clock = std::chrono::steady_clock;
+        phase_times *_times;
+        phase _phase;
+        clock::time_point _start;
+
+        void stop(clock::time_point now) {
+            std::chrono::duration<double> elapsed = now - _start;
+            _times->seconds[_phase] += elapsed.count();
+            _times->timed[_phase] = true;
+        }
+
+    public:
+        phase_timer(phase_times *times, phase which) : _times(times), _phase(which) {
+            if (_times) _start = clock::now();
+        }
+        ~phase_timer() {
+            if (_times) stop(clock::now());
+        }
+
+        void next(phase which) {
+            if (!_times) return;
+            clock::time_point now = clock::now();
+            stop(now);
+            _phase = which;
+            _start = now;
+        }
+
+        phase_timer(const phase_timer &) = delete;
+        phase_timer & operator=(const phase_timer &) = delete;
+};
+
+}
+
+#endif
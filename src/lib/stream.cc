@@ -0,0 +1,538 @@
+/***************************************************************************************************
+    File: stream.cc
+
+    Description:
+        The streaming contexts of libhuffman. The encoder gathers one block of input (in a
+        buffer that grows with it, up to STREAM_BLOCK_SIZE by default), plans its code, and
+        packs the codes straight into whatever output space drain is given, keeping the bits
+        of an unfinished word in its bit writer. The decoder keeps a small window of
+        compressed input and the bit offset into it, and decodes as many symbols as the bits
+        in the window are sure to hold.
+
+***************************************************************************************************/
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include "huffman.h"
+#include "../codec/bitReader.h"
+#include "../codec/bitWriter.h"
+#include "../codec/block.h"
+#include "../codec/canonical.h"
+#include "../codec/contextModel.h"
+#include "../codec/decodeTable.h"
+#include "../codec/fileHeader.h"
+#include "../codec/format.h"
+#include "phaseTimer.h"
+
+namespace huffman {
+
+namespace {
+
+size_t fail(error code) {
+    return (size_t)0 - (size_t)code;
+}
+
+// first size of the block buffer of a stream encoder
+const size_t STREAM_BLOCK_START = 4 << 10;
+
+options stream_defaults() {
+    // those of compress -B, with blocks small enough for many open streams
+
+    options settings;
+    settings.block_size = STREAM_BLOCK_SIZE;
+    return settings;
+}
+
+}
+
+// pending holds bytes waiting for output space: the container header, the head
+// of a frame, the end marker, or codes packed there when drain is given less
+// room than a whole word
+struct stream_encoder::state {
+    options settings;
+    std::vector<unsigned char> block;
+    size_t filled;                      // bytes of input in block
+    unsigned char pending[BLOCKS_HEADER_SIZE + BLOCK_HEAD_BOUND + 8];
+    size_t pending_start, pending_end;
+    block_plan plan;
+    bool planned;                       // the block is full (or final) and has a plan
+    size_t coded;                       // bytes of the planned block already packed
+    bit_writer writer;
+    bool finishing, ended;
+    error err;
+
+    state() : writer(nullptr) {}
+
+    void start() {
+        // the container header, without a block index
+
+        filled = 0;
+        pending[0] = FORMAT_MAGIC[0];
+        pending[1] = FORMAT_MAGIC[1];
+        pending[2] = FORMAT_BLOCKS;
+        pending[3] = 0;
+        store_le(pending + 4, settings.block_size, 4);
+        pending_start = 0;
+        pending_end = BLOCKS_HEADER_SIZE;
+        planned = finishing = ended = false;
+        writer = bit_writer(nullptr);
+        err = ERROR_NONE;
+    }
+
+    void plan_next() {
+        // append the head of the frame of the gathered block to what is pending
+
+        std::memmove(pending, pending + pending_start, pending_end - pending_start);
+        pending_end -= pending_start;
+        pending_start = 0;
+        size_t size = plan_block(block.data(), filled, settings.max_bits, settings.streams,
+                                 settings.min_gain, plan, pending + pending_end);
+        if (size == 0) {
+            err = ERROR_CODE_TOO_LONG;
+            return;
+        }
+        pending_end += size;
+        planned = true;
+        coded = plan.kind == BLOCK_RUN ? filled : 0;    // a run is all in its head
+    }
+};
+
+stream_encoder::stream_encoder() : stream_encoder(stream_defaults()) {}
+
+stream_encoder::stream_encoder(const options & settings) : _state(new state) {
+    _state->settings = settings;
+    _state->settings.index = false;
+    bool valid = settings.block_size >= MIN_BLOCK_SIZE && settings.block_size <= MAX_BLOCK_SIZE &&
+                 settings.max_bits <= CANONICAL_MAX_BITS &&
+                 settings.streams >= 1 && settings.streams <= MAX_STREAMS &&
+                 settings.min_gain < 100;
+    _state->start();
+    if (!valid) _state->err = ERROR_PARAMETER;
+}
+
+stream_encoder::~stream_encoder() {}
+
+void stream_encoder::reset() {
+    bool valid = _state->err != ERROR_PARAMETER;
+    _state->start();
+    if (!valid) _state->err = ERROR_PARAMETER;
+}
+
+size_t stream_encoder::feed(const void *src, size_t size) {
+    // copy into the block until it is full, then plan it. The block grows with the
+    // input, doubling up to the block size, so a short stream holds little memory.
+
+    state & s = *_state;
+    if (s.err || s.finishing || s.planned) return 0;
+    size_t block_size = s.settings.block_size;
+    size_t n = std::min(size, block_size - s.filled);
+    if (s.filled + n > s.block.size()) {
+        s.block.resize(std::min(block_size, std::max({s.filled + n, 2 * s.block.size(),
+                                                      STREAM_BLOCK_START})));
+    }
+    std::memcpy(s.block.data() + s.filled, src, n);
+    s.filled += n;
+    if (s.filled == block_size) s.plan_next();
+    return n;
+}
+
+void stream_encoder::finish() {
+    // the last block may be short
+
+    state & s = *_state;
+    if (s.finishing) return;
+    s.finishing = true;
+    if (!s.err && !s.planned && s.filled > 0) s.plan_next();
+}
+
+bool stream_encoder::done() const {
+    return _state->ended && _state->pending_start == _state->pending_end;
+}
+
+size_t stream_encoder::drain(void *dst, size_t capacity) {
+    // pending bytes first, then codes of the planned block, its last bits, and
+    // after finish the end marker
+
+    state & s = *_state;
+    unsigned char *out = static_cast<unsigned char *>(dst);
+    if (s.err) return fail(s.err);
+
+    size_t written = 0;
+    while (written < capacity) {
+        if (s.pending_start < s.pending_end) {
+            size_t n = std::min(capacity - written, s.pending_end - s.pending_start);
+            std::memcpy(out + written, s.pending + s.pending_start, n);
+            s.pending_start += n;
+            written += n;
+            continue;
+        }
+        s.pending_start = s.pending_end = 0;
+
+        if (s.planned && s.coded < s.filled && s.plan.kind == BLOCK_STORED) {
+            size_t n = std::min(capacity - written, s.filled - s.coded);
+            std::memcpy(out + written, s.block.data() + s.coded, n);
+            s.coded += n;
+            written += n;
+        }
+        else if (s.planned && s.coded < s.filled) {
+            // the writer stores whole words; with less room than two of them,
+            // the codes go to pending first
+            size_t room = capacity - written;
+            bool direct = room >= 16;
+            unsigned char *target = direct ? out + written : s.pending;
+            if (!direct) room = sizeof(s.pending);
+            size_t count = ((room * 8 - 63) / s.plan.max_length);
+            count = std::min(count, s.filled - s.coded);
+
+            s.writer.rebase(target);
+            const unsigned char *in = s.block.data() + s.coded;
+            for (size_t i = 0; i < count; i++) {
+                s.writer.put(s.plan.codes[in[i]], s.plan.lengths[in[i]]);
+            }
+            s.coded += count;
+            if (direct) written += s.writer.size();
+            else s.pending_end = s.writer.size();
+        }
+        else if (s.planned) {
+            // the last bits of the block, padded to a byte
+            s.writer.rebase(s.pending);
+            s.writer.flush();
+            s.pending_end = s.writer.size();
+            s.planned = false;
+            s.filled = 0;
+        }
+        else if (s.finishing && !s.ended) {
+            std::memset(s.pending, 0, 4);
+            s.pending_end = 4;
+            s.ended = true;
+        }
+        else {
+            break;
+        }
+    }
+    return written;
+}
+
+// input[start, end) is the compressed input not yet used, and the first skip
+// bits of input[start] are already decoded
+struct stream_decoder::state {
+    enum phase_type { MAGIC, FILE_HEADER, CONTEXT_HEADER, BLOCKS_HEADER, FRAME_HEADER, BITS,
+                      DONE };
+
+    std::vector<unsigned char> input;
+    size_t start, end;
+    unsigned skip;
+    bool finished;
+    phase_type phase;
+    format_version format;
+    size_t block_size;
+    decode_table table;
+    file_code code;                 // the code of the original or canonical format
+    context_code context;           // and of the context format
+    context_decoder contexts;
+    unsigned char previous;         // the context of the next byte of the context format
+    unsigned max_length;
+    int single;                     // the only byte of a code or a run, or -1
+    bool stored;                    // the frame holds the bytes as they are
+    uint64_t remaining;             // bytes left to decode in the current frame (or file)
+    uint64_t bits, bits_used;       // bit count of the current frame and bits decoded so far
+    error err;
+
+    phase_times *times;             // where the phases are timed, or null
+
+    state(size_t buffer_size, phase_times *times) : input(buffer_size), times(times) {}
+
+    void restart() {
+        start = end = 0;
+        skip = 0;
+        finished = false;
+        stored = false;
+        phase = MAGIC;
+        err = ERROR_NONE;
+    }
+
+    size_t available() const { return end - start; }
+
+    // whether the header being read cannot grow any more
+    bool stuck() const { return finished || available() == input.size(); }
+};
+
+stream_decoder::stream_decoder(size_t buffer_size, phase_times *times)
+    : _state(new state(std::max(buffer_size, STREAM_BUFFER_SIZE), times)) {
+    _state->restart();
+}
+
+stream_decoder::~stream_decoder() {}
+
+void stream_decoder::reset() {
+    _state->restart();
+}
+
+size_t stream_decoder::feed(const void *src, size_t size) {
+    // move what is left to the front of the window and append; anything after
+    // the end of the compressed data (the block index) is taken and dropped
+
+    state & s = *_state;
+    if (s.finished) return 0;
+    if (s.phase == state::DONE) return size;
+    std::memmove(s.input.data(), s.input.data() + s.start, s.available());
+    s.end -= s.start;
+    s.start = 0;
+    size_t n = std::min(size, s.input.size() - s.end);
+    std::memcpy(s.input.data() + s.end, src, n);
+    s.end += n;
+    return n;
+}
+
+void stream_decoder::finish() {
+    _state->finished = true;
+}
+
+bool stream_decoder::done() const {
+    return _state->phase == state::DONE;
+}
+
+size_t stream_decoder::drain(void *dst, size_t capacity) {
+    // read headers once they are whole in the window, and decode bits as far
+    // as the window and the output space allow
+
+    state & s = *_state;
+    unsigned char *out = static_cast<unsigned char *>(dst);
+    if (s.err) return fail(s.err);
+
+    // everything but reading the header of a format with one code and building its
+    // tables is decoding, including the frames of the block format
+    phase_timer timer(s.times, PHASE_CODING);
+    size_t written = 0;
+    bool corrupt = false;
+    bool waiting = false;           // more input is needed to go on
+    while (!corrupt && !waiting && s.phase != state::DONE) {
+        const unsigned char *in = s.input.data() + s.start;
+        size_t available = s.available();
+
+        switch (s.phase) {
+            case state::MAGIC:
+                if (available == 0) {
+                    if (s.finished) s.phase = state::DONE;     // empty input, empty output
+                    else waiting = true;
+                }
+                else if (in[0] != FORMAT_MAGIC[0]) {
+                    s.format = FORMAT_LEGACY;
+                    s.phase = state::FILE_HEADER;
+                }
+                else if (available < 3) {
+                    corrupt = s.finished;
+                    waiting = true;
+                }
+                else if (in[1] != FORMAT_MAGIC[1] ||
+                         (in[2] != FORMAT_CANONICAL && in[2] != FORMAT_BLOCKS &&
+                          in[2] != FORMAT_CONTEXT)) {
+                    corrupt = true;
+                }
+                else {
+                    s.format = (format_version)in[2];
+                    s.phase = s.format == FORMAT_CANONICAL ? state::FILE_HEADER :
+                              s.format == FORMAT_CONTEXT ? state::CONTEXT_HEADER :
+                              state::BLOCKS_HEADER;
+                }
+                break;
+
+            case state::FILE_HEADER: {
+                // the size and tree of the original format, or the size and code lengths
+                // of the canonical one; any whole header fits in the window
+                timer.next(PHASE_HEADER);
+                size_t head = read_file_header(in, available, s.code);
+                timer.next(PHASE_CODING);
+                size_t bound = s.format == FORMAT_LEGACY ? LEGACY_HEAD_BOUND
+                                                         : CANONICAL_HEAD_BOUND;
+                if (head == 0) {
+                    corrupt = s.stuck() || available >= bound;
+                    waiting = true;
+                    break;
+                }
+                s.single = s.code.single;
+                s.stored = false;
+                s.remaining = s.code.file_size;
+                s.max_length = s.code.max_length;
+                timer.next(PHASE_CODES);
+                corrupt = s.single < 0 && s.remaining > 0 &&
+                          !s.table.build(s.code.codes, s.code.lengths, 256);
+                timer.next(PHASE_CODING);
+                s.bits = 0;
+                s.start += head;
+                s.phase = state::BITS;
+                break;
+            }
+
+            case state::CONTEXT_HEADER: {
+                // the header holds the sizes of its code length tables, so its size is
+                // found a piece at a time; the window grows when it is too small for it
+                size_t head = CONTEXT_HEADER_SIZE;
+                unsigned groups = available >= head ? in[11] : 0;
+                bool whole = available >= head && groups <= MAX_CONTEXT_GROUPS;
+                if (whole) head += context_map_size(groups);
+                for (unsigned g = 0; whole && g < groups; g++) {
+                    whole = available >= head + 2 &&
+                            load_le(in + head, 2) <= code_lengths_bound(256);
+                    if (whole) head += 2 + load_le(in + head, 2);
+                }
+                if (!whole || available < head) {
+                    corrupt = s.finished || groups > MAX_CONTEXT_GROUPS ||
+                              available >= CONTEXT_HEAD_BOUND;
+                    if (available == s.input.size() && available < CONTEXT_HEAD_BOUND) {
+                        s.input.resize(CONTEXT_HEAD_BOUND);
+                    }
+                    waiting = true;
+                    break;
+                }
+                uint64_t size;
+                timer.next(PHASE_HEADER);
+                corrupt = read_context_header(in, head, s.context, size) != head;
+                timer.next(PHASE_CODES);
+                corrupt = corrupt || !s.contexts.build(s.context);
+                timer.next(PHASE_CODING);
+                s.single = s.context.single;
+                s.stored = false;
+                s.remaining = size;
+                s.max_length = s.contexts.max_length();
+                s.previous = 0;
+                s.bits = 0;
+                s.start += head;
+                s.phase = state::BITS;
+                break;
+            }
+
+            case state::BLOCKS_HEADER:
+                if (available < BLOCKS_HEADER_SIZE) {
+                    corrupt = s.finished;
+                    waiting = true;
+                    break;
+                }
+                s.block_size = load_le(in + 4, 4);
+                corrupt = s.block_size > MAX_BLOCK_SIZE;
+                s.start += BLOCKS_HEADER_SIZE;
+                s.phase = state::FRAME_HEADER;
+                break;
+
+            case state::FRAME_HEADER: {
+                // the end marker, or the header and tables of a frame
+                if (available >= 4 && block_uncompressed_size(in) == 0) {
+                    s.start += 4;
+                    s.phase = state::DONE;
+                    break;
+                }
+                if (available < BLOCK_HEADER_SIZE || available < block_bits_offset(in)) {
+                    corrupt = s.finished;
+                    waiting = true;
+                    break;
+                }
+                size_t size = block_uncompressed_size(in);
+                block_kind kind = block_type(in);
+                if (size > s.block_size ||
+                    (kind == BLOCK_STORED && load_le(in + 4, 4) != (uint64_t)size * 8) ||
+                    (kind == BLOCK_CODED && !read_block_table(in, s.table))) {
+                    corrupt = true;
+                    break;
+                }
+                // the streams follow each other, so the bits decode as one stream
+                s.max_length = kind == BLOCK_CODED ? s.table.max_length() : 8;
+                s.single = kind == BLOCK_RUN ? in[BLOCK_HEADER_SIZE] : -1;
+                s.stored = kind == BLOCK_STORED;
+                s.remaining = size;
+                s.bits = load_le(in + 4, 4);
+                s.bits_used = 0;
+                s.start += block_bits_offset(in);
+                s.phase = state::BITS;
+                break;
+            }
+
+            case state::BITS: {
+                if (s.remaining == 0) {
+                    // the bits of a frame end on a byte boundary
+                    if (s.format == FORMAT_BLOCKS && s.bits_used != s.bits) {
+                        corrupt = true;
+                        break;
+                    }
+                    if (s.skip) {
+                        s.start++;
+                        s.skip = 0;
+                    }
+                    s.phase = s.format == FORMAT_BLOCKS ? state::FRAME_HEADER : state::DONE;
+                    break;
+                }
+                if (written == capacity) {
+                    waiting = true;
+                    break;
+                }
+                size_t n = (size_t)std::min<uint64_t>(s.remaining, capacity - written);
+                if (s.single >= 0) {
+                    std::memset(out + written, s.single, n);
+                    written += n;
+                    s.remaining -= n;
+                    break;
+                }
+                if (s.stored) {
+                    // frames start on a byte, so the stored bytes are whole in the window
+                    n = std::min(n, available);
+                    if (n == 0) {
+                        corrupt = s.finished;
+                        waiting = true;
+                        break;
+                    }
+                    std::memcpy(out + written, in, n);
+                    s.start += n;
+                    s.bits_used += n * 8;
+                    written += n;
+                    s.remaining -= n;
+                    break;
+                }
+
+                // unless the rest of the bits are all in the window, decode only
+                // the symbols whose codes are sure to be there
+                uint64_t window_bits = (uint64_t)available * 8 - s.skip;
+                bool whole = s.format == FORMAT_BLOCKS ? window_bits >= s.bits - s.bits_used
+                                                       : s.finished;
+                if (!whole) {
+                    n = (size_t)std::min<uint64_t>(n, window_bits / s.max_length);
+                    if (n == 0) {
+                        corrupt = s.finished;
+                        waiting = true;
+                        break;
+                    }
+                }
+
+                bit_reader reader(in, available);
+                reader.refill();
+                reader.consume(s.skip);
+                bool ok = s.format == FORMAT_CONTEXT
+                        ? s.contexts.decode(reader, out + written, n, s.previous)
+                        : s.table.decode(reader, out + written, n);
+                if (!ok || reader.position() > available * 8) {
+                    corrupt = true;
+                    break;
+                }
+                s.bits_used += reader.position() - s.skip;
+                if (s.format == FORMAT_BLOCKS && s.bits_used > s.bits) {
+                    corrupt = true;
+                    break;
+                }
+                s.start += reader.position() / 8;
+                s.skip = reader.position() % 8;
+                written += n;
+                s.remaining -= n;
+                break;
+            }
+
+            case state::DONE:
+                break;
+        }
+    }
+
+    if (corrupt) {
+        s.err = ERROR_CORRUPT;
+        return fail(s.err);
+    }
+    return written;
+}
+
+}
@@ -3,71 +3,85 @@
 
     Description:
         A min heap class to define all methods and functions that enabled the main features of
-        a min heap. A min heap is a tree data structure in which the tree is a complete binary
-        tree. Elements found in a min heap are arranged by their priority values. Element at
-        the root of a min heap must have a priority value less or equal to the rest of elements.
-        A min heap is easy to element using the data structure of a priority queue. Since the
-        queue was based on a single-link-list, the min heap will not actually look like a tree
-        since each node only has a child. The min-heap in this implementation is a psuedo-tree.
+        a min heap. A min heap is a tree data structure in which the tree is a complete tree.
+        Elements found in a min heap are arranged by their priority values. Element at the root
+        of a min heap must have a priority value less or equal to the rest of elements. The
+        tree is kept in an array, level by level, so a node finds its parent and children by
+        index. Each node has Arity children (2 for a binary heap; 4 halves the depth, which
+        pays off for large heaps whose levels do not fit in the cache).
         Example
                      0           1                 2                3                  4
         Min-Heap: [root] -> [Left child1] -> [Right child1] -> [Left child2] -> [Right child 2]
 
+        The order comes from a comparator object, std::less by default: cmp(a, b) is true if
+        a must leave the heap before b. Being part of the type, it is inlined into the sift
+        loops. Elements are moved, never copied, inside the heap.
+
 ***************************************************************************************************/
-#ifndef PQ
-#define PQ
+#ifndef MIN_HEAP_H
+#define MIN_HEAP_H
 
-template <typename T>
-class min_heap {
-  // priority-queue-based min-heap
+#include <cstddef>
+#include <functional>
+#include <vector>
 
-    private:
-        size_t _capacity;                     // capacity of the queue
-        size_t _size;                         // amount of data is in the queue
-        int (*_cmp)(const T &, const T &);    // comparison function _cmp to assign priority value
-        T *_data;                             // data pointer
+template <typename T, typename Compare = std::less<T>, size_t Arity = 2>
+class min_heap {
+  // array-based min-heap
 
-        // wih the data at the given node index, return its parent's node index
-        size_t _parent(size_t k);
+    static_assert(Arity >= 2, "a heap node needs at least two children");
 
-        // with the data at the given node index, return the index of its left child
-        size_t _left_child(size_t k);
+    private:
+        std::vector<T> _data;       // the nodes, level by level
+        Compare _cmp;               // comparison object to assign priority value
 
-        // with the data at the given node index, return the index of its right child
-        size_t _right_child(size_t k);
+        // with the data at the given node index, return its parent's node index
+        static size_t _parent(size_t k) { return (k - 1) / Arity; }
 
-        // swapping the data between two queue nodes
-        void _swap(size_t x, size_t y);
+        // with the data at the given node index, return the index of its first child
+        static size_t _first_child(size_t k) { return k * Arity + 1; }
 
-        // helper function to rearrange the last element up the queue
-        // until the queue is sorted by the elements' priority values
+        // move the element at k up the heap until its parent comes before it
         void _reheap_up(size_t k);
 
-        // helper function rearrange rearrange the top element down the queue
-        // until the queue is sorted by the elements' priority values
+        // move the element at k down the heap until it comes before its children
         void _reheap_down(size_t k);
 
-        // double the capacity of the queue, while keeping all
-        // the data of the original.
-        void _grow();
-
     public:
 
-        // initialize a priority-queue-based min-heap and its properties
-        min_heap(int (*cmp)(const T &, const T &));
+        // initialize an empty min-heap
+        explicit min_heap(const Compare & cmp = Compare());
+
+        // initialize a min-heap with the elements of [first, last), arranged in linear time
+        template <typename Iterator>
+        min_heap(Iterator first, Iterator last, const Compare & cmp = Compare());
+
+        // replace the elements of the heap with those of [first, last)
+        template <typename Iterator>
+        void assign(Iterator first, Iterator last);
+
+        // make room for n elements without growing
+        void reserve(size_t n);
 
         // add new item to the queue
         void add(const T & item);
+        void add(T && item);
 
         // remove the root/top element of the queue
         void remove();
 
+        // remove the root/top element of the queue and return it
+        T take();
+
         // return the data of the element at the root/top from the queue
-        T front() const;
+        const T & front() const;
 
         // return the size of the queue
         size_t size() const;
+        bool empty() const;
 
+        // remove every element, keeping the storage
+        void clear();
 };
 
 #include "minHeap.cc"
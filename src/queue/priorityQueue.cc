@@ -1,51 +1,87 @@
 /***************************************************************************************************
-    File: priorityQueue.h
+    File: priorityQueue.cc
 
     Description:
-        A priority queue class to define all methods and functions that enabled the main features
-        of a priority queue. A priority queue allows user to store and arrange elements based on
-        the elements' priority values. Elements with higher priority values are retrievable
-        before elements with lower priority values. Each element has its priority value, which is
-        assigned when it was added to the queue. We use the data structure of a linked-list to
-        store the data of the element in the queue. Linked-list makes it easier to manage elements
-        such as by streamline the process of  adding, rearranging, and removing elements
+        The member functions of priority_queue. Adding walks the list from the front to the
+        first element the new one has priority over, so it takes time in proportion to the
+        size of the queue; the queue suits short queues and queues that are mostly added to
+        in order.
 
 ***************************************************************************************************/
+#include <algorithm>
+#include <utility>
+#include <vector>
 
-template <typename T>
-priority_queue<T>::priority_queue(int (*cmp)(const T &, const T &)) {
-    // Initialize a priority queue
+template <typename T, typename Compare>
+priority_queue<T, Compare>::priority_queue(const Compare & cmp)
+    : _cmp(cmp), _front(nullptr), _size(0) {}
 
-    _front = NULL;
-    _size = 0;
-    _cmp = cmp;
+template <typename T, typename Compare>
+template <typename Iterator>
+priority_queue<T, Compare>::priority_queue(Iterator first, Iterator last, const Compare & cmp)
+    : _cmp(cmp), _front(nullptr), _size(0) {
+    // sort the elements once, then link them up from the back, instead of walking
+    // the list for every element. Equal elements end up in the order adding them one
+    // by one would give: the last one first.
+
+    std::vector<T> items(first, last);
+    std::reverse(items.begin(), items.end());
+    std::stable_sort(items.begin(), items.end(), _cmp);
+    for (size_t i = items.size(); i-- > 0;) _front = new node(std::move(items[i]), _front);
+    _size = items.size();
 }
 
-template <typename T>
-priority_queue<T>::node::node(const T & item, node * rest)  // Initalize an element in queue
-    : data(item), next(rest) {}
+template <typename T, typename Compare>
+priority_queue<T, Compare>::~priority_queue() {
+    clear();
+}
 
-template <typename T>
-void priority_queue<T>::_add_helper(const T & item, node * & lst) {
-    // Queueu management helper to rearrange elements using priority values
+template <typename T, typename Compare>
+priority_queue<T, Compare>::priority_queue(priority_queue && other)
+    : _cmp(std::move(other._cmp)), _front(other._front), _size(other._size) {
+    other._front = nullptr;
+    other._size = 0;
+}
 
-    if (lst == NULL)
-        lst = new node(item, NULL);
-    else if (_cmp(item, lst->data) <= 0)
-        lst = new node(item, lst);
-    else _add_helper(item, lst->next);
+template <typename T, typename Compare>
+priority_queue<T, Compare> & priority_queue<T, Compare>::operator=(priority_queue && other) {
+    if (this != &other) {
+        clear();
+        _cmp = std::move(other._cmp);
+        _front = other._front;
+        _size = other._size;
+        other._front = nullptr;
+        other._size = 0;
+    }
+    return *this;
 }
 
-template <typename T>
-void priority_queue<T>::add(const T & item) {
-    // Add element to a priority queue
+template <typename T, typename Compare>
+template <typename U>
+void priority_queue<T, Compare>::_add_helper(U && item) {
+    // Queue management helper to rearrange elements using priority values: skip the
+    // elements with priority over item, and link item in before the rest
 
-    _add_helper(item, _front);
+    node **link = &_front;
+    while (*link && _cmp((*link)->data, item)) link = &(*link)->next;
+    *link = new node(std::forward<U>(item), *link);
     _size++;
 }
 
-template <typename T>
-void priority_queue<T>::remove() {
+template <typename T, typename Compare>
+void priority_queue<T, Compare>::add(const T & item) {
+    // Add element to a priority queue
+
+    _add_helper(item);
+}
+
+template <typename T, typename Compare>
+void priority_queue<T, Compare>::add(T && item) {
+    _add_helper(std::move(item));
+}
+
+template <typename T, typename Compare>
+void priority_queue<T, Compare>::remove() {
     // Remove element from queue
 
     node * dead = _front;
@@ -54,16 +90,33 @@ void priority_queue<T>::remove() {
     _size--;
 }
 
-template <typename T>
-T priority_queue<T>::front() const {
+template <typename T, typename Compare>
+T priority_queue<T, Compare>::take() {
+    T item = std::move(_front->data);
+    remove();
+    return item;
+}
+
+template <typename T, typename Compare>
+const T & priority_queue<T, Compare>::front() const {
     // Return the data of element with highest priority value in queue
 
     return _front->data;
 }
 
-template <typename T>
-size_t priority_queue<T>::size() const {
+template <typename T, typename Compare>
+size_t priority_queue<T, Compare>::size() const {
     // Return the size of the queue
 
     return _size;
 }
+
+template <typename T, typename Compare>
+bool priority_queue<T, Compare>::empty() const {
+    return _size == 0;
+}
+
+template <typename T, typename Compare>
+void priority_queue<T, Compare>::clear() {
+    while (_front) remove();
+}
@@ -10,22 +10,31 @@
         store the data of the element in the queue. Linked-list makes it easier to manage elements
         such as by streamline the process of  adding, rearranging, and removing elements
 
+        The priority comes from a comparator object, std::less by default: cmp(a, b) is true if
+        a has the higher priority, and an element goes before those of equal priority. The
+        queue owns its nodes and frees them; it can be moved but not copied.
+
 ***************************************************************************************************/
-#ifndef PQ
-#define PQ
+#ifndef PRIORITY_QUEUE_H
+#define PRIORITY_QUEUE_H
+
+#include <cstddef>
+#include <functional>
+#include <utility>
 
-template <typename T>
+template <typename T, typename Compare = std::less<T>>
 class priority_queue {
     private:
         // linked-list-based queue
         struct node {
             T data;                     // node data
             node *next;                 // node pointer
-            node(const T &, node *);
+            template <typename U>
+            node(U && item, node *rest) : data(std::forward<U>(item)), next(rest) {}
         };
 
-        // Comparison function _cmp to assign priority value to an element
-        int (*_cmp)(const T &, const T &);
+        // Comparison object to assign priority value to an element
+        Compare _cmp;
 
         // Pointer to keep track of the element with the highest priority value
         node *_front;
@@ -33,24 +42,45 @@ class priority_queue {
         // Size of the queue
         size_t _size;
 
-        // Function to help rearrange element using the priority values
-        void _add_helper(const T &, node * &);
+        // Function to link a new element in before the first one it has priority over
+        template <typename U>
+        void _add_helper(U && item);
 
     public:
         // Initialize the priority queue and its properties
-        priority_queue(int (*cmp)(const T &, const T &));
+        explicit priority_queue(const Compare & cmp = Compare());
+
+        // Initialize the priority queue with the elements of [first, last)
+        template <typename Iterator>
+        priority_queue(Iterator first, Iterator last, const Compare & cmp = Compare());
+
+        // Free every node of the queue
+        ~priority_queue();
+
+        priority_queue(priority_queue && other);
+        priority_queue & operator=(priority_queue && other);
+        priority_queue(const priority_queue &) = delete;
+        priority_queue & operator=(const priority_queue &) = delete;
 
         // Function to add item to queue
         void add(const T & item);
+        void add(T && item);
 
         // Function to remove item from queue
         void remove();
 
+        // Function to remove item from queue and return it
+        T take();
+
         // Function to get the element with highest priority queue
-        T front() const;
+        const T & front() const;
 
         // Function to get the size of queue
         size_t size() const;
+        bool empty() const;
+
+        // Function to remove every item from queue
+        void clear();
 };
 
 #include "priorityQueue.cc"
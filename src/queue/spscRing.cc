@@ -0,0 +1,35 @@
+/***************************************************************************************************
+    File: spscRing.cc
+
+    Description:
+        The member functions of spsc_ring. A slot is written before the index that hands it
+        over is released, and read after the index is acquired, so the element is visible to
+        the other thread by the time it can reach the slot.
+
+***************************************************************************************************/
+
+template <typename T>
+spsc_ring<T>::spsc_ring(size_t capacity) : _head(0), _tail(0) {
+    size_t slots = 1;
+    while (slots < capacity) slots *= 2;
+    _slots.resize(slots);
+    _mask = slots - 1;
+}
+
+template <typename T>
+bool spsc_ring<T>::try_push(const T & item) {
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    if (tail - _head.load(std::memory_order_acquire) == _slots.size()) return false;
+    _slots[tail & _mask] = item;
+    _tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+template <typename T>
+bool spsc_ring<T>::try_pop(T & item) {
+    size_t head = _head.load(std::memory_order_relaxed);
+    if (head == _tail.load(std::memory_order_acquire)) return false;
+    item = _slots[head & _mask];
+    _head.store(head + 1, std::memory_order_release);
+    return true;
+}
@@ -0,0 +1,48 @@
+/***************************************************************************************************
+    File: spscRing.h
+
+    Description:
+        A bounded queue between exactly one producer thread and one consumer thread. The
+        elements sit in a ring of slots; the producer only writes the tail and the consumer
+        only writes the head, so neither takes a lock: each reads the other's index with
+        acquire ordering to see the slots it published. try_push fails when the ring is full
+        and try_pop when it is empty, and the caller decides how to wait. The two indices are
+        kept on separate cache lines so the threads do not contend for one.
+
+***************************************************************************************************/
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+template <typename T>
+class spsc_ring {
+    private:
+        std::vector<T> _slots;
+        size_t _mask;                           // slots - 1, a power of two minus one
+
+        // indices count up forever and are masked into the ring
+        alignas(64) std::atomic<size_t> _head;  // next slot to pop, written by the consumer
+        alignas(64) std::atomic<size_t> _tail;  // next slot to push, written by the producer
+
+    public:
+        // room for at least capacity elements
+        explicit spsc_ring(size_t capacity);
+
+        spsc_ring(const spsc_ring &) = delete;
+        spsc_ring & operator=(const spsc_ring &) = delete;
+
+        // producer: add an element, or return false if the ring is full
+        bool try_push(const T & item);
+
+        // consumer: take the oldest element, or return false if the ring is empty
+        bool try_pop(T & item);
+
+        size_t capacity() const { return _slots.size(); }
+};
+
+#include "spscRing.cc"
+
+#endif
@@ -0,0 +1,48 @@
+#!/bin/sh
+####################################################################################################
+#   File: programs.sh
+#
+#   Description:
+#       What the round trip test cannot see from the library: how uncompress treats damaged
+#       data when standard output is a regular file it maps. Run by make test with the
+#       directory of the programs:
+#
+#           src/test/programs.sh builds
+#
+#       A canonical file whose header claims 2^40 bytes must fail as it does from a pipe,
+#       without sizing the output file to the claim.
+#
+####################################################################################################
+builds=$1
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+failures=0
+
+fail() {
+    echo "FAIL $1"
+    failures=$((failures + 1))
+}
+
+head -c 3000 "$(dirname "$0")/../../README.md" > "$work/original"
+"$builds/compress" -c "$work/original" > "$work/good.hz"
+# the 8 bytes after the magic and version are the size, little-endian: 2^40
+{ head -c 3 "$work/good.hz"; printf '\000\000\000\000\000\001\000\000'
+  tail -c +12 "$work/good.hz"; } > "$work/bad.hz"
+
+# with a limit on the file size, sizing the output to the claim kills uncompress with
+# SIGXFSZ instead of filling the disk
+( ulimit -f 2048; exec "$builds/uncompress" < "$work/bad.hz" > "$work/out" ) 2> /dev/null
+status=$?
+if [ $status -eq 0 ]; then
+    fail "uncompress took a size of 2^40 in a 3K file"
+elif [ $status -gt 128 ]; then
+    fail "uncompress sized its output to a size of 2^40"
+fi
+"$builds/uncompress" < "$work/good.hz" > "$work/out" && cmp -s "$work/out" "$work/original" ||
+    fail "uncompress of the undamaged file"
+
+if [ $failures -ne 0 ]; then
+    echo "$failures checks failed"
+    exit 1
+fi
+echo "all program checks passed"
@@ -0,0 +1,547 @@
+/***************************************************************************************************
+    File: roundTrip.cc
+
+    Description:
+        Round trips and damaged input for every format of libhuffman: the original format,
+        canonical (version 1), blocks (2), shared table (3), contexts (4) and symbols (5),
+        and the stream encoder and decoder:
+
+            make test
+
+        builds builds/test_round_trip and runs it. Every check that fails is printed with
+        the format and corpus it failed on, and the program exits with 1 if any did.
+
+        Each format codes a set of generated corpora (empty, one byte, a run of one byte,
+        two bytes, text, random bytes and a skewed distribution over several blocks) and
+        must give them back exactly, through decompress and, for the formats it reads,
+        through a stream_decoder fed in pieces of every size. Then the compressed data is
+        damaged:
+
+            destination     one byte too small for compress or decompress gives
+                            ERROR_DESTINATION_TOO_SMALL
+            truncation      a prefix of the data gives an error, or the original when
+                            only padding was cut off, from decompress and the stream decoder
+            bit flips       a flipped bit gives an error or some output that fits in the
+                            destination; nothing reads or writes out of bounds
+            sizes           a header that claims more bytes than its bits can hold is
+                            corrupt, however large the destination, and nothing is decoded
+
+***************************************************************************************************/
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "../lib/huffman.h"
+
+namespace {
+
+using bytes = std::vector<unsigned char>;
+
+int failures = 0;
+
+void check(bool ok, const std::string & what) {
+    if (ok) return;
+    std::printf("FAIL %s\n", what.c_str());
+    std::fflush(stdout);
+    failures++;
+}
+
+// a 64-bit linear congruential generator, so every run sees the same corpora
+struct generator {
+    uint64_t state = 0x9e3779b97f4a7c15;
+
+    uint32_t next() {
+        state = state * 6364136223846793005 + 1442695040888963407;
+        return (uint32_t)(state >> 32);
+    }
+};
+
+struct corpus {
+    std::string name;
+    bytes data;
+};
+
+std::vector<corpus> make_corpora() {
+    generator random;
+    std::vector<corpus> corpora = {{"empty", {}}, {"byte", {'x'}},
+                                   {"run", bytes(100000, 'a')}, {"two", bytes(5000)},
+                                   {"text", {}}, {"random", bytes(100000)},
+                                   {"skewed", bytes(300000)}};
+    for (size_t i = 0; i < corpora[3].data.size(); i++) corpora[3].data[i] = "ab"[i % 3 == 0];
+
+    static const char *words[] = {"the", "of", "and", "huffman", "code", "tree", "a", "bits",
+                                  "table", "block", "to", "in", "canonical", "length"};
+    bytes & text = corpora[4].data;
+    while (text.size() < 200000) {
+        const char *word = words[random.next() % 14];
+        text.insert(text.end(), word, word + std::char_traits<char>::length(word));
+        text.push_back(random.next() % 11 ? ' ' : '\n');
+    }
+
+    for (unsigned char & c : corpora[5].data) c = (unsigned char)random.next();
+
+    // byte k with a probability about 2^-k/2, so codes of many lengths occur
+    for (unsigned char & c : corpora[6].data) {
+        uint32_t r = random.next() | 1;
+        int k = 0;
+        while (!(r & 3)) r >>= 2, k++;
+        c = (unsigned char)(k * 16 + random.next() % 3);
+    }
+    return corpora;
+}
+
+struct format_case {
+    std::string name;
+    huffman::options settings;
+    bool stream;                    // a stream_decoder reads it
+};
+
+std::vector<format_case> make_cases() {
+    std::vector<format_case> cases;
+    auto add = [&](const char *name, bool stream, auto set) {
+        huffman::options settings;
+        set(settings);
+        cases.push_back({name, settings, stream});
+    };
+    add("legacy", true, [](huffman::options & o) { o.format = huffman::OUTPUT_LEGACY; });
+    add("canonical", true, [](huffman::options & o) { o.format = huffman::OUTPUT_CANONICAL; });
+    add("canonical-l9", true, [](huffman::options & o) {
+        o.format = huffman::OUTPUT_CANONICAL;
+        o.max_bits = 9;
+    });
+    add("canonical-sample", true, [](huffman::options & o) {
+        o.format = huffman::OUTPUT_CANONICAL;
+        o.sample_size = 4096;
+    });
+    add("blocks", true, [](huffman::options &) {});
+    add("blocks-small", true, [](huffman::options & o) {
+        o.block_size = 4 << 10;
+        o.streams = 1;
+        o.min_gain = 0;
+        o.index = false;
+    });
+    add("blocks-sync", true, [](huffman::options & o) {
+        o.block_size = 64 << 10;
+        o.sync_interval = 4096;
+    });
+    add("context", true, [](huffman::options & o) { o.format = huffman::OUTPUT_CONTEXT; });
+    add("context-1", true, [](huffman::options & o) {
+        o.format = huffman::OUTPUT_CONTEXT;
+        o.context_groups = 1;
+    });
+    add("context-64", true, [](huffman::options & o) {
+        o.format = huffman::OUTPUT_CONTEXT;
+        o.context_groups = 64;
+    });
+    return cases;
+}
+
+// decode z with a stream_decoder, fed in pieces of piece bytes and drained into pieces
+// of out_piece bytes, up to a little more than limit bytes (damaged data may claim any
+// size). Returns the decoded size or the error drain gave; stuck is set if the decoder
+// stopped without finishing or reporting an error.
+size_t stream_decode(const bytes & z, size_t piece, size_t out_piece, size_t limit, bytes & out,
+                     bool & stuck) {
+    huffman::stream_decoder decoder;
+    bytes buffer(out_piece);
+    size_t at = 0;
+    bool finished = false;
+    int idle = 0;
+    out.clear();
+    stuck = false;
+    while (!decoder.done()) {
+        if (at < z.size()) at += decoder.feed(z.data() + at, std::min(piece, z.size() - at));
+        else if (!finished) decoder.finish(), finished = true;
+        size_t n = decoder.drain(buffer.data(), buffer.size());
+        if (huffman::is_error(n)) return n;
+        out.insert(out.end(), buffer.begin(), buffer.begin() + n);
+        if (out.size() > limit) break;
+        idle = n == 0 && finished ? idle + 1 : 0;
+        if (idle > 2) {
+            stuck = true;
+            return 0;
+        }
+    }
+    return out.size();
+}
+
+// the positions to cut or flip a bit at: all of them in small data, a spread of them
+// and the last few bytes in larger data
+std::vector<size_t> positions(size_t size, generator & random) {
+    std::vector<size_t> at;
+    if (size <= 64) {
+        for (size_t i = 0; i < size; i++) at.push_back(i);
+        return at;
+    }
+    for (size_t i = 0; i < 48; i++) at.push_back(i * size / 48);
+    for (size_t i = 1; i <= 8; i++) at.push_back(size - i);
+    for (size_t i = 0; i < 16; i++) at.push_back(random.next() % std::min<size_t>(size, 512));
+    return at;
+}
+
+// the damage every decoder of data z of the original d must survive, with
+// decode(src, size, dst, capacity) decompressing and, if stream, a stream_decoder too
+template <typename Decode>
+void damage(const std::string & name, const bytes & d, const bytes & z, Decode decode,
+            bool stream, generator & random) {
+    bytes out(d.size() + 1);
+
+    if (!d.empty()) {
+        size_t n = decode(z.data(), z.size(), out.data(), d.size() - 1);
+        check(huffman::get_error(n) == huffman::ERROR_DESTINATION_TOO_SMALL,
+              name + ": decompress into one byte too few");
+    }
+
+    for (size_t cut : positions(z.size(), random)) {
+        if (cut == 0) continue;         // no bytes at all are the empty input
+        size_t n = decode(z.data(), cut, out.data(), out.size());
+        bool exact = n == d.size() && std::equal(d.begin(), d.end(), out.begin());
+        check(huffman::is_error(n) || exact,
+              name + ": truncated to " + std::to_string(cut) + " bytes");
+        if (stream && cut < z.size()) {
+            bytes part(z.begin(), z.begin() + cut), streamed;
+            bool stuck;
+            n = stream_decode(part, 4096, 4096, d.size(), streamed, stuck);
+            check(!stuck, name + ": stream decoder stuck on " + std::to_string(cut) + " bytes");
+            check(huffman::is_error(n) || streamed == d,
+                  name + ": stream truncated to " + std::to_string(cut) + " bytes");
+        }
+    }
+
+    bytes flipped = z;
+    for (size_t at : positions(z.size(), random)) {
+        unsigned bit = 1u << random.next() % 8;
+        flipped[at] ^= bit;
+        size_t n = decode(flipped.data(), flipped.size(), out.data(), out.size());
+        check(huffman::is_error(n) || n <= out.size(),
+              name + ": bit flip at " + std::to_string(at));
+        if (stream) {
+            bytes streamed;
+            bool stuck;
+            stream_decode(flipped, 1000, 4096, d.size(), streamed, stuck);
+            check(!stuck, name + ": stream decoder stuck on a bit flip at " +
+                          std::to_string(at));
+        }
+        flipped[at] ^= bit;
+    }
+}
+
+void test_formats(const std::vector<corpus> & corpora) {
+    // every format of the encoder, then through decompress and the stream decoder
+
+    generator random;
+    huffman::decoder decoder;
+    auto decode = [&](const unsigned char *src, size_t size, unsigned char *dst,
+                      size_t capacity) {
+        return decoder.decompress(src, size, dst, capacity);
+    };
+    for (const format_case & format : make_cases()) {
+        huffman::encoder encoder(format.settings);
+        for (const corpus & c : corpora) {
+            std::string name = format.name + "/" + c.name;
+            const bytes & d = c.data;
+            bytes z(huffman::compress_bound(d.size(), format.settings));
+            size_t n = encoder.compress(d.data(), d.size(), z.data(), z.size());
+            check(!huffman::is_error(n), name + ": compress: " + huffman::error_message(n));
+            if (huffman::is_error(n)) continue;
+            z.resize(n);
+
+            check(huffman::decompressed_size(z.data(), z.size()) == d.size(),
+                  name + ": decompressed_size");
+            bytes out(d.size());
+            n = decoder.decompress(z.data(), z.size(), out.data(), out.size());
+            check(n == d.size() && out == d, name + ": decompress");
+
+            if (!z.empty()) {
+                // a code built from a sample is built again from all of the input when
+                // it does not fit, and may then fit
+                bytes small(z.size() - 1);
+                n = encoder.compress(d.data(), d.size(), small.data(), small.size());
+                bool fits = !huffman::is_error(n) &&
+                            huffman::decompress(small.data(), n, out.data(), out.size()) ==
+                            d.size() && out == d;
+                check(huffman::get_error(n) == huffman::ERROR_DESTINATION_TOO_SMALL ||
+                      (format.settings.sample_size && fits),
+                      name + ": compress into one byte too few");
+            }
+
+            if (format.stream) {
+                for (size_t piece : {(size_t)1, (size_t)3, (size_t)1000, z.size() + 1}) {
+                    for (size_t out_piece : {(size_t)1, (size_t)7, (size_t)65536}) {
+                        if ((piece < 1000 || out_piece < 7) && z.size() + d.size() > 50000) {
+                            continue;
+                        }
+                        bytes streamed;
+                        bool stuck;
+                        n = stream_decode(z, piece, out_piece, d.size(), streamed, stuck);
+                        check(!stuck && n == d.size() && streamed == d,
+                              name + ": stream decoder in pieces of " + std::to_string(piece) +
+                              " and " + std::to_string(out_piece));
+                    }
+                }
+            }
+
+            damage(name, d, z, decode, format.stream, random);
+        }
+    }
+}
+
+void test_inflated_sizes(const std::vector<corpus> & corpora) {
+    // the canonical and context formats with the size in their header raised just past
+    // what the bits can hold, far past it, and into the values of error codes
+
+    const bytes & d = corpora[4].data;
+    for (huffman::output_format format : {huffman::OUTPUT_CANONICAL, huffman::OUTPUT_CONTEXT}) {
+        std::string name = format == huffman::OUTPUT_CANONICAL ? "canonical" : "context";
+        huffman::options settings;
+        settings.format = format;
+        bytes z(huffman::compress_bound(d.size(), settings));
+        z.resize(huffman::compress(d.data(), d.size(), z.data(), z.size(), settings));
+        bytes out(z.size() * 8 + 1);
+        for (uint64_t claim : {(uint64_t)out.size(), (uint64_t)1 << 40, (uint64_t)0 - 2}) {
+            bytes bad = z;
+            for (int i = 0; i < 8; i++) bad[3 + i] = (unsigned char)(claim >> 8 * i);
+            std::string what = name + ": a size of " + std::to_string(claim);
+            check(huffman::get_error(huffman::decompressed_size(bad.data(), bad.size())) ==
+                  huffman::ERROR_CORRUPT, what + " from decompressed_size");
+            size_t n = huffman::decompress(bad.data(), bad.size(), out.data(), out.size());
+            check(huffman::get_error(n) == huffman::ERROR_CORRUPT &&
+                  std::all_of(out.begin(), out.end(), [](unsigned char c) { return c == 0; }),
+                  what + " into " + std::to_string(out.size()) + " bytes");
+        }
+    }
+}
+
+void test_phase_times(const std::vector<corpus> & corpora) {
+    // every phase of the canonical format is timed on the way in, and on the way out
+    // the header (which holds the code lengths), the decoding tables and the decoding
+
+    const bytes & d = corpora[4].data;
+    huffman::phase_times in, out;
+    huffman::options settings;
+    settings.format = huffman::OUTPUT_CANONICAL;
+    settings.times = &in;
+    bytes z(huffman::compress_bound(d.size(), settings)), back(d.size());
+    z.resize(huffman::compress(d.data(), d.size(), z.data(), z.size(), settings));
+    huffman::decoder decoder(&out);
+    decoder.decompress(z.data(), z.size(), back.data(), back.size());
+    for (int p = 0; p < huffman::PHASE_COUNT; p++) {
+        check(in.timed[p], "phase times: phase " + std::to_string(p) + " of compress");
+        check(out.timed[p] == (p >= huffman::PHASE_CODES),
+              "phase times: phase " + std::to_string(p) + " of decompress");
+    }
+}
+
+void test_stream_encoder(const std::vector<corpus> & corpora) {
+    // the block format in pieces of input and output of every size
+
+    for (const corpus & c : corpora) {
+        const bytes & d = c.data;
+        for (size_t piece : {(size_t)1, (size_t)7, (size_t)4096, d.size() + 1}) {
+            for (size_t out_piece : {(size_t)1, (size_t)5, (size_t)4096}) {
+                if ((piece < 4096 || out_piece < 4096) && d.size() > 10000) continue;
+                huffman::options settings;
+                settings.block_size = 4 << 10;
+                huffman::stream_encoder encoder(settings);
+                bytes z, buffer(out_piece);
+                size_t at = 0;
+                bool ok = true;
+                while (ok && !encoder.done()) {
+                    if (at < d.size()) {
+                        at += encoder.feed(d.data() + at, std::min(piece, d.size() - at));
+                    }
+                    else encoder.finish();
+                    size_t n = encoder.drain(buffer.data(), buffer.size());
+                    ok = !huffman::is_error(n);
+                    if (ok) z.insert(z.end(), buffer.begin(), buffer.begin() + n);
+                }
+                bytes out(d.size());
+                size_t n = ok ? huffman::decompress(z.data(), z.size(), out.data(), out.size())
+                              : 0;
+                check(ok && n == d.size() && out == d,
+                      "stream encoder/" + c.name + ": pieces of " + std::to_string(piece) +
+                      " and " + std::to_string(out_piece));
+            }
+        }
+    }
+
+    // without options, blocks of STREAM_BLOCK_SIZE
+    const bytes & d = corpora[6].data;
+    huffman::stream_encoder small;
+    bytes z(huffman::compress_bound(d.size())), out(d.size());
+    size_t at = 0, written = 0;
+    while (!small.done()) {
+        if (at < d.size()) at += small.feed(d.data() + at, d.size() - at);
+        else small.finish();
+        written += small.drain(z.data() + written, z.size() - written);
+    }
+    check(z[4] + (z[5] << 8) + (z[6] << 16) == (int)huffman::STREAM_BLOCK_SIZE &&
+          huffman::decompress(z.data(), written, out.data(), out.size()) == d.size() && out == d,
+          "stream encoder: blocks of STREAM_BLOCK_SIZE without options");
+
+    huffman::options bad;
+    bad.block_size = 1;
+    huffman::stream_encoder encoder(bad);
+    unsigned char buffer[64];
+    check(huffman::get_error(encoder.drain(buffer, sizeof(buffer))) == huffman::ERROR_PARAMETER,
+          "stream encoder: a block size out of range");
+}
+
+void test_stream_errors(const std::vector<corpus> & corpora) {
+    // data that is not compressed, and a reused decoder
+
+    bytes garbage = {'H', 'Z', 9, 0, 0, 0, 0, 0};
+    bytes out;
+    bool stuck;
+    size_t n = stream_decode(garbage, 8, 64, 0, out, stuck);
+    check(huffman::get_error(n) == huffman::ERROR_CORRUPT, "stream decoder: an unknown version");
+    bytes text(corpora[4].data.begin(), corpora[4].data.begin() + 100);
+    n = stream_decode(text, 100, 64, 0, out, stuck);
+    check(huffman::get_error(n) == huffman::ERROR_CORRUPT, "stream decoder: plain text");
+
+    const bytes & d = corpora[6].data;
+    bytes z(huffman::compress_bound(d.size()));
+    z.resize(huffman::compress(d.data(), d.size(), z.data(), z.size()));
+    huffman::stream_decoder decoder;
+    bytes buffer(d.size());
+    for (int round = 0; round < 2; round++) {
+        decoder.feed(garbage.data(), garbage.size());
+        check(huffman::is_error(decoder.drain(buffer.data(), buffer.size())),
+              "stream decoder: garbage before reset");
+        decoder.reset();
+        size_t at = 0, written = 0;
+        while (!decoder.done() && at <= z.size()) {
+            at += decoder.feed(z.data() + at, z.size() - at);
+            if (at == z.size()) decoder.finish();
+            n = decoder.drain(buffer.data() + written, buffer.size() - written);
+            if (huffman::is_error(n)) break;
+            written += n;
+        }
+        check(decoder.done() && written == d.size() && buffer == d,
+              "stream decoder: decoding after reset");
+        decoder.reset();
+    }
+}
+
+void test_table(const std::vector<corpus> & corpora) {
+    // the shared table format, with its table, without it and with another one
+
+    generator random;
+    const bytes & d = corpora[4].data;
+    huffman::shared_table table, other;
+    table.add_sample(d.data(), 20000);
+    check(!huffman::is_error(table.train()), "table: train");
+    other.add_sample(corpora[6].data.data(), 20000);
+    check(!huffman::is_error(other.train()), "table: train another");
+
+    bytes file(huffman::TABLE_FILE_BOUND);
+    size_t n = table.save(file.data(), file.size());
+    huffman::shared_table loaded;
+    check(!huffman::is_error(n) && loaded.load(file.data(), n) == n && loaded.id() == table.id(),
+          "table: save and load");
+
+    huffman::encoder encoder;
+    huffman::decoder decoder;
+    for (const corpus & c : corpora) {
+        std::string name = "table/" + c.name;
+        bytes z(huffman::compress_bound(c.data.size(), table));
+        n = encoder.compress(table, c.data.data(), c.data.size(), z.data(), z.size());
+        check(!huffman::is_error(n), name + ": compress");
+        if (huffman::is_error(n)) continue;
+        z.resize(n);
+        bytes out(c.data.size());
+        n = decoder.decompress(loaded, z.data(), z.size(), out.data(), out.size());
+        check(n == c.data.size() && out == c.data, name + ": decompress");
+        if (c.data.empty()) continue;
+        check(huffman::get_error(decoder.decompress(z.data(), z.size(), out.data(), out.size())) ==
+              huffman::ERROR_TABLE, name + ": without the table");
+        check(huffman::get_error(decoder.decompress(other, z.data(), z.size(), out.data(),
+                                                    out.size())) == huffman::ERROR_TABLE,
+              name + ": with another table");
+        damage(name, c.data, z, [&](const unsigned char *src, size_t size, unsigned char *dst,
+                                    size_t capacity) {
+            return decoder.decompress(table, src, size, dst, capacity);
+        }, false, random);
+    }
+}
+
+template <typename Symbol>
+void test_symbol_array(const std::string & name, const std::vector<Symbol> & symbols,
+                       generator & random) {
+    // an array of symbols, decoded as symbols and as little-endian bytes
+
+    huffman::encoder encoder;
+    huffman::decoder decoder;
+    bytes z(huffman::compress_symbols_bound(symbols.size()));
+    size_t n = encoder.compress_symbols(symbols.data(), symbols.size(), z.data(), z.size());
+    check(!huffman::is_error(n), name + ": compress_symbols");
+    if (huffman::is_error(n)) return;
+    z.resize(n);
+
+    check(huffman::decompressed_symbols(z.data(), z.size()) == symbols.size(),
+          name + ": decompressed_symbols");
+    std::vector<Symbol> out(symbols.size());
+    n = decoder.decompress_symbols(z.data(), z.size(), out.data(), out.size());
+    check(n == symbols.size() && out == symbols, name + ": decompress_symbols");
+
+    bytes d(symbols.size() * sizeof(Symbol));
+    for (size_t i = 0; i < d.size(); i++) d[i] = (unsigned char)(symbols[i / sizeof(Symbol)] >>
+                                                                   8 * (i % sizeof(Symbol)));
+    bytes out_bytes(d.size());
+    n = decoder.decompress(z.data(), z.size(), out_bytes.data(), out_bytes.size());
+    check(n == d.size() && out_bytes == d, name + ": decompress as bytes");
+
+    damage(name, d, z, [&](const unsigned char *src, size_t size, unsigned char *dst,
+                           size_t capacity) {
+        return decoder.decompress(src, size, dst, capacity);
+    }, false, random);
+}
+
+void test_symbols() {
+    // both widths: skewed, a single symbol, none, and symbols out of range
+
+    generator random;
+    std::vector<uint16_t> narrow(50000);
+    std::vector<uint32_t> wide(50000);
+    for (size_t i = 0; i < narrow.size(); i++) {
+        uint32_t r = random.next();
+        narrow[i] = (uint16_t)(r % 7 ? r % 300 : r >> 16);
+        wide[i] = 65535u - narrow[i];
+    }
+    test_symbol_array("symbols16/skewed", narrow, random);
+    test_symbol_array("symbols32/skewed", wide, random);
+    test_symbol_array("symbols16/single", std::vector<uint16_t>(30000, 7), random);
+    test_symbol_array("symbols32/single", std::vector<uint32_t>(30000, 65535), random);
+    test_symbol_array("symbols16/empty", std::vector<uint16_t>(), random);
+
+    bytes z(huffman::compress_symbols_bound(wide.size()));
+    wide[1234] = huffman::MAX_SYMBOLS;
+    size_t n = huffman::compress_symbols(wide.data(), wide.size(), z.data(), z.size());
+    check(huffman::get_error(n) == huffman::ERROR_SYMBOL, "symbols32: a symbol out of range");
+
+    n = huffman::compress_symbols(narrow.data(), narrow.size(), z.data(), z.size());
+    std::vector<uint32_t> other(narrow.size());
+    check(huffman::get_error(huffman::decompress_symbols(z.data(), n, other.data(),
+                                                         other.size())) ==
+          huffman::ERROR_PARAMETER, "symbols16: decompressed as 32-bit symbols");
+}
+
+}
+
+int main() {
+    std::vector<corpus> corpora = make_corpora();
+    test_formats(corpora);
+    test_inflated_sizes(corpora);
+    test_phase_times(corpora);
+    test_stream_encoder(corpora);
+    test_stream_errors(corpora);
+    test_table(corpora);
+    test_symbols();
+    if (failures) {
+        std::printf("%d checks failed\n", failures);
+        return 1;
+    }
+    std::printf("all checks passed\n");
+    return 0;
+}